@@ -0,0 +1,279 @@
+#pragma once
+
+#include "parser.hpp"
+
+#define CHECK_PARSER(p) \
+	static_assert(!parser::analyze(p).infinite_loop, "repetition of a parser that can succeed without consuming any input"); \
+	static_assert(parser::GrammarWarning<parser::analyze(p).overlapping_choice>::check(), "");
+
+namespace parser {
+
+class CharSet {
+	std::uint64_t words[4];
+	static constexpr unsigned int index(char c) {
+		return static_cast<unsigned char>(c);
+	}
+public:
+	constexpr CharSet(): words{0, 0, 0, 0} {}
+	constexpr CharSet(char c): CharSet() {
+		insert(c);
+	}
+	constexpr CharSet(char first, char last): CharSet() {
+		for (unsigned int i = index(first); i <= index(last); ++i) {
+			words[i / 64] |= std::uint64_t(1) << i % 64;
+		}
+	}
+	static constexpr CharSet all() {
+		return CharSet('\x00', '\xFF');
+	}
+	constexpr void insert(char c) {
+		words[index(c) / 64] |= std::uint64_t(1) << index(c) % 64;
+	}
+	constexpr bool contains(char c) const {
+		return words[index(c) / 64] >> index(c) % 64 & 1;
+	}
+	constexpr bool empty() const {
+		return (words[0] | words[1] | words[2] | words[3]) == 0;
+	}
+	constexpr std::size_t size() const {
+		std::size_t count = 0;
+		for (unsigned int i = 0; i < 256; ++i) {
+			count += words[i / 64] >> i % 64 & 1;
+		}
+		return count;
+	}
+	constexpr bool intersects(const CharSet& rhs) const {
+		return ((words[0] & rhs.words[0]) | (words[1] & rhs.words[1]) | (words[2] & rhs.words[2]) | (words[3] & rhs.words[3])) != 0;
+	}
+	constexpr CharSet operator |(const CharSet& rhs) const {
+		CharSet result;
+		for (unsigned int i = 0; i < 4; ++i) {
+			result.words[i] = words[i] | rhs.words[i];
+		}
+		return result;
+	}
+	constexpr bool operator ==(const CharSet& rhs) const {
+		return words[0] == rhs.words[0] && words[1] == rhs.words[1] && words[2] == rhs.words[2] && words[3] == rhs.words[3];
+	}
+};
+
+class GrammarInfo {
+public:
+	static constexpr std::size_t UNBOUNDED = -1;
+	// whether the parser can succeed without consuming any input
+	bool nullable;
+	// the characters a successful non-empty match can start with
+	CharSet first;
+	// the number of characters a successful match consumes
+	std::size_t min_length;
+	std::size_t max_length;
+	// whether the parser can return ERROR without consuming any input, for example error() or expect()
+	bool eager_error;
+	// a repetition (or a Pratt operator) whose body can succeed without consuming any input
+	bool infinite_loop;
+	// a choice whose alternatives can start with the same character after an unbounded alternative
+	bool overlapping_choice;
+	constexpr GrammarInfo(bool nullable, CharSet first, std::size_t min_length, std::size_t max_length, bool eager_error = false, bool infinite_loop = false, bool overlapping_choice = false): nullable(nullable), first(first), min_length(min_length), max_length(max_length), eager_error(eager_error), infinite_loop(infinite_loop), overlapping_choice(overlapping_choice) {}
+	static constexpr GrammarInfo fail() {
+		// never succeeds
+		return GrammarInfo(false, CharSet(), UNBOUNDED, 0);
+	}
+	static constexpr GrammarInfo empty() {
+		return GrammarInfo(true, CharSet(), 0, 0);
+	}
+	static constexpr GrammarInfo unknown() {
+		// can succeed or fail at any character
+		return GrammarInfo(true, CharSet::all(), 0, UNBOUNDED, true);
+	}
+	static constexpr std::size_t add(std::size_t lhs, std::size_t rhs) {
+		return lhs == UNBOUNDED || rhs == UNBOUNDED ? UNBOUNDED : lhs + rhs;
+	}
+	// whether the parser has to be tried at the given character (or at the end of the input if c is -1)
+	constexpr bool can_start_with(int c) const {
+		return nullable || eager_error || (c >= 0 && first.contains(static_cast<char>(c)));
+	}
+	constexpr GrammarInfo then(const GrammarInfo& rhs) const {
+		return GrammarInfo(
+			nullable && rhs.nullable,
+			nullable ? first | rhs.first : first,
+			add(min_length, rhs.min_length),
+			add(max_length, rhs.max_length),
+			eager_error || (nullable && rhs.eager_error),
+			infinite_loop || rhs.infinite_loop,
+			overlapping_choice || rhs.overlapping_choice
+		);
+	}
+	constexpr GrammarInfo or_(const GrammarInfo& rhs) const {
+		return GrammarInfo(
+			nullable || rhs.nullable,
+			first | rhs.first,
+			min_length < rhs.min_length ? min_length : rhs.min_length,
+			max_length > rhs.max_length ? max_length : rhs.max_length,
+			eager_error || rhs.eager_error,
+			infinite_loop || rhs.infinite_loop,
+			overlapping_choice || rhs.overlapping_choice || (max_length == UNBOUNDED && first.intersects(rhs.first))
+		);
+	}
+	constexpr GrammarInfo repeated() const {
+		return GrammarInfo(
+			true,
+			first,
+			0,
+			max_length == 0 ? 0 : UNBOUNDED,
+			eager_error,
+			infinite_loop || nullable,
+			overlapping_choice
+		);
+	}
+	constexpr GrammarInfo with_infinite_loop(bool infinite_loop) const {
+		return GrammarInfo(nullable, first, min_length, max_length, eager_error, this->infinite_loop || infinite_loop, overlapping_choice);
+	}
+	constexpr GrammarInfo lookahead() const {
+		return GrammarInfo(true, CharSet(), 0, 0, eager_error, infinite_loop, overlapping_choice);
+	}
+};
+
+template <bool overlapping_choice> class GrammarWarning {
+public:
+	static constexpr bool check() {
+		return true;
+	}
+};
+template <> class GrammarWarning<true> {
+public:
+	[[deprecated("a choice has overlapping alternatives after an unbounded alternative, this can cause super-linear backtracking")]] static constexpr bool check() {
+		return true;
+	}
+};
+
+template <class... T> class TypeList {
+public:
+	constexpr TypeList() {}
+};
+
+template <class T, class L> struct type_list_contains: std::false_type {};
+template <class T, class... L> struct type_list_contains<T, TypeList<T, L...>>: std::true_type {};
+template <class T, class L0, class... L> struct type_list_contains<T, TypeList<L0, L...>>: type_list_contains<T, TypeList<L...>> {};
+
+template <class F> constexpr CharSet get_char_set(const F& f) {
+	// arbitrary predicates are not evaluated at compile time
+	return CharSet::all();
+}
+constexpr CharSet get_char_set(const Char& f) {
+	return CharSet(f.c);
+}
+constexpr CharSet get_char_set(const AnyChar& f) {
+	return CharSet::all();
+}
+constexpr CharSet get_char_set(const CharRange& f) {
+	return f.first <= f.last ? CharSet(f.first, f.last) : CharSet();
+}
+constexpr CharSet get_char_set(const OneOf& f) {
+	CharSet result;
+	for (char c: f.chars) {
+		result.insert(c);
+	}
+	return result;
+}
+
+template <class F, class V> constexpr GrammarInfo analyze_impl(const CharClass<F>& p, V) {
+	return GrammarInfo(false, get_char_set(p.f), 1, 1);
+}
+
+template <class V> constexpr GrammarInfo analyze_impl(char c, V) {
+	return GrammarInfo(false, CharSet(c), 1, 1);
+}
+
+template <class V> constexpr GrammarInfo analyze_impl(bool (*f)(char), V) {
+	return GrammarInfo(false, CharSet::all(), 1, 1);
+}
+
+template <class V> constexpr GrammarInfo analyze_impl(const StringView& s, V) {
+	return s.empty() ? GrammarInfo::empty() : GrammarInfo(false, CharSet(s[0]), s.size(), s.size());
+}
+
+template <class V> constexpr GrammarInfo analyze_impl(const char* s, V v) {
+	return analyze_impl(StringView(s), v);
+}
+
+template <class V> constexpr GrammarInfo analyze_impl(const Sequence<>& p, V) {
+	return GrammarInfo::empty();
+}
+template <class P0, class... P, class V> constexpr GrammarInfo analyze_impl(const Sequence<P0, P...>& p, V v) {
+	return analyze_impl(p.head, v).then(analyze_impl(p.tail, v));
+}
+
+template <class V> constexpr GrammarInfo analyze_impl(const Choice<>& p, V) {
+	return GrammarInfo::fail();
+}
+template <class P0, class... P, class V> constexpr GrammarInfo analyze_impl(const Choice<P0, P...>& p, V v) {
+	return analyze_impl(p.head, v).or_(analyze_impl(p.tail, v));
+}
+
+template <class P, class V> constexpr GrammarInfo analyze_impl(const Repetition<P>& p, V v) {
+	return analyze_impl(p.p, v).repeated();
+}
+
+template <class P, class V> constexpr GrammarInfo analyze_impl(const Not<P>& p, V v) {
+	return analyze_impl(p.p, v).lookahead();
+}
+
+template <class P, class V> constexpr GrammarInfo analyze_impl(const Until<P>& p, V v) {
+	const GrammarInfo info = analyze_impl(p.p, v);
+	return GrammarInfo(true, CharSet::all(), 0, GrammarInfo::UNBOUNDED, info.eager_error, info.infinite_loop, info.overlapping_choice);
+}
+
+template <class P, class V> constexpr GrammarInfo analyze_impl(const Ignore_<P>& p, V v) {
+	return analyze_impl(p.p, v);
+}
+
+template <class P, class V> constexpr GrammarInfo analyze_impl(const CollectString<P>& p, V v) {
+	return analyze_impl(p.p, v);
+}
+
+template <class T, class P, class V> constexpr GrammarInfo analyze_impl(const Map<T, P>& p, V v) {
+	return analyze_impl(p.p, v);
+}
+
+template <class T, class P, class V> constexpr GrammarInfo analyze_impl(const Collect<T, P>& p, V v) {
+	return analyze_impl(p.p, v);
+}
+
+template <class P, class V> constexpr GrammarInfo analyze_impl(const CollectLocation<P>& p, V v) {
+	return analyze_impl(p.p, v);
+}
+
+template <class V> constexpr GrammarInfo analyze_impl(const Error_& p, V) {
+	return GrammarInfo(false, CharSet(), GrammarInfo::UNBOUNDED, 0, true);
+}
+
+template <class V> constexpr GrammarInfo analyze_impl(const Expect& p, V v) {
+	const GrammarInfo info = analyze_impl(p.s, v);
+	return GrammarInfo(info.nullable, info.first, info.min_length, info.max_length, true);
+}
+
+template <class T, class... V> constexpr GrammarInfo analyze_reference(std::true_type, TypeList<V...>) {
+	// recursive reference; assume it consumes at least one character and contributes nothing to the first set
+	return GrammarInfo(false, CharSet(), 1, GrammarInfo::UNBOUNDED);
+}
+template <class T, class... V> constexpr GrammarInfo analyze_reference(std::false_type, TypeList<V...>) {
+	return analyze_impl(T::parser, TypeList<V..., T>());
+}
+template <class T, class V> constexpr GrammarInfo analyze_impl(const Reference_<T>& p, V v) {
+	return analyze_reference<T>(type_list_contains<T, V>(), v);
+}
+
+// used while a grammar is still being defined and references cannot be followed yet
+class OpaqueReferences {
+public:
+	constexpr OpaqueReferences() {}
+};
+template <class T> constexpr GrammarInfo analyze_impl(const Reference_<T>& p, OpaqueReferences) {
+	return GrammarInfo::unknown();
+}
+
+template <class P> constexpr GrammarInfo analyze(const P& p) {
+	return analyze_impl(p, TypeList<>());
+}
+
+}
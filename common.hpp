@@ -7,6 +7,19 @@
 #include <string>
 #include <vector>
 #include <iterator>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PARSER_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PARSER_NOINLINE __declspec(noinline)
+#else
+#define PARSER_NOINLINE __attribute__((noinline))
+#endif
 
 template <class...> using void_t = void;
 template <bool B, class T = void> using enable_if_t = typename std::enable_if<B, T>::type;
@@ -284,6 +297,149 @@ public:
 	}
 };
 
+inline unsigned int count_trailing_zeros(unsigned int x) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, x);
+	return index;
+#else
+	return __builtin_ctz(x);
+#endif
+}
+inline unsigned int count_trailing_zeros(std::uint64_t x) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, x);
+	return index;
+#else
+	return __builtin_ctzll(x);
+#endif
+}
+// x must not be 0
+inline unsigned int count_leading_zeros(std::uint64_t x) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, x);
+	return 63 - index;
+#else
+	return __builtin_clzll(x);
+#endif
+}
+
+// finds the next occurrence of one of a few characters, 16 characters at a time if SSE2 is available
+class CharFinder {
+	static constexpr std::size_t MAX_CHARS = 8;
+	char chars[MAX_CHARS];
+	std::size_t count;
+public:
+	CharFinder(): count(0) {}
+	// returns false if there is no room for another character
+	bool insert(char c) {
+		if (contains(c)) {
+			return true;
+		}
+		if (count == MAX_CHARS) {
+			return false;
+		}
+		chars[count] = c;
+		++count;
+		return true;
+	}
+	bool contains(char c) const {
+		for (std::size_t i = 0; i < count; ++i) {
+			if (chars[i] == c) {
+				return true;
+			}
+		}
+		return false;
+	}
+	const char* find(const char* position, const char* end) const {
+#ifdef PARSER_SSE2
+		__m128i needles[MAX_CHARS];
+		for (std::size_t i = 0; i < count; ++i) {
+			needles[i] = _mm_set1_epi8(chars[i]);
+		}
+		while (end - position >= 16) {
+			const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position));
+			__m128i matches = _mm_setzero_si128();
+			for (std::size_t i = 0; i < count; ++i) {
+				matches = _mm_or_si128(matches, _mm_cmpeq_epi8(block, needles[i]));
+			}
+			const unsigned int mask = _mm_movemask_epi8(matches);
+			if (mask != 0) {
+				return position + count_trailing_zeros(mask);
+			}
+			position += 16;
+		}
+#endif
+		while (position < end && !contains(*position)) {
+			++position;
+		}
+		return position;
+	}
+	// like find() but the last block is also searched with a vector load, which requires at least 16 readable bytes after end
+	const char* find_padded(const char* position, const char* end) const {
+#ifdef PARSER_SSE2
+		__m128i needles[MAX_CHARS];
+		for (std::size_t i = 0; i < count; ++i) {
+			needles[i] = _mm_set1_epi8(chars[i]);
+		}
+		while (position < end) {
+			const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position));
+			__m128i matches = _mm_setzero_si128();
+			for (std::size_t i = 0; i < count; ++i) {
+				matches = _mm_or_si128(matches, _mm_cmpeq_epi8(block, needles[i]));
+			}
+			const unsigned int mask = _mm_movemask_epi8(matches);
+			if (mask != 0) {
+				const char* match = position + count_trailing_zeros(mask);
+				return match < end ? match : end;
+			}
+			position += 16;
+		}
+		return end;
+#else
+		return find(position, end);
+#endif
+	}
+};
+
+// returns the first occurrence of s in [position, end) or end if there is none
+inline const char* find_string(const char* position, const char* end, const StringView& s) {
+	if (s.empty()) {
+		return position;
+	}
+	if (s.size() == 1) {
+		const void* result = std::memchr(position, s[0], end - position);
+		return result ? static_cast<const char*>(result) : end;
+	}
+#ifdef PARSER_SSE2
+	// compare the first and the last character of s at 16 positions at once and only check the candidates
+	const __m128i first = _mm_set1_epi8(s[0]);
+	const __m128i last = _mm_set1_epi8(s[s.size() - 1]);
+	while (end - position >= static_cast<std::ptrdiff_t>(s.size() - 1 + 16)) {
+		const __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position));
+		const __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position + s.size() - 1));
+		unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+		while (mask != 0) {
+			const char* candidate = position + count_trailing_zeros(mask);
+			if (std::memcmp(candidate + 1, s.data() + 1, s.size() - 2) == 0) {
+				return candidate;
+			}
+			mask &= mask - 1;
+		}
+		position += 16;
+	}
+#endif
+	while (end - position >= static_cast<std::ptrdiff_t>(s.size())) {
+		if (std::memcmp(position, s.data(), s.size()) == 0) {
+			return position;
+		}
+		++position;
+	}
+	return end;
+}
+
 inline std::uint32_t next_code_point(StringView& s) {
 	std::uint32_t code_point = 0;
 	if (s.size() >= 1 && (s[0] & 0b1000'0000) == 0b0000'0000) {
@@ -393,3 +549,80 @@ public:
 		return SourceLocation(begin, rhs.end);
 	}
 };
+
+class SourcePosition {
+public:
+	// both start at 1, the column counts bytes
+	unsigned int line;
+	std::size_t column;
+	constexpr SourcePosition(unsigned int line, std::size_t column): line(line), column(column) {}
+};
+
+// the offsets at which the lines of a source start, built once so that every offset can be resolved to a line with a binary search
+class LineIndex {
+	std::vector<std::size_t> line_starts;
+	std::size_t size;
+	static std::size_t count_newlines(const char* position, const char* end) {
+		std::size_t count = 0;
+#ifdef PARSER_SSE2
+		const __m128i newline = _mm_set1_epi8('\n');
+		while (end - position >= 16) {
+			// each match subtracts -1 from its byte, which can count up to 255 blocks before the bytes are summed
+			__m128i counts = _mm_setzero_si128();
+			for (std::size_t blocks = std::min<std::size_t>((end - position) / 16, 255); blocks > 0; --blocks) {
+				const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position));
+				counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(block, newline));
+				position += 16;
+			}
+			const __m128i sums = _mm_sad_epu8(counts, _mm_setzero_si128());
+			count += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+		}
+#endif
+		for (; position < end; ++position) {
+			count += *position == '\n';
+		}
+		return count;
+	}
+public:
+	LineIndex(): line_starts(1, 0), size(0) {}
+	LineIndex(const StringView& source): size(source.size()) {
+		line_starts.reserve(count_newlines(source.begin(), source.end()) + 1);
+		line_starts.push_back(0);
+		const char* position = source.begin();
+#ifdef PARSER_SSE2
+		const __m128i newline = _mm_set1_epi8('\n');
+		while (source.end() - position >= 16) {
+			const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position));
+			unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+			while (mask != 0) {
+				line_starts.push_back(position - source.begin() + count_trailing_zeros(mask) + 1);
+				mask &= mask - 1;
+			}
+			position += 16;
+		}
+#endif
+		for (; position < source.end(); ++position) {
+			if (*position == '\n') {
+				line_starts.push_back(position - source.begin() + 1);
+			}
+		}
+	}
+	unsigned int get_line_count() const {
+		return line_starts.size();
+	}
+	// the line of an offset, starting at 1
+	unsigned int get_line(std::size_t offset) const {
+		return std::upper_bound(line_starts.begin(), line_starts.end(), offset) - line_starts.begin();
+	}
+	std::size_t get_line_start(unsigned int line) const {
+		return line_starts[line - 1];
+	}
+	// the offset of the newline at the end of a line or the size of the source for the last line
+	std::size_t get_line_end(unsigned int line) const {
+		return line < line_starts.size() ? line_starts[line] - 1 : size;
+	}
+	SourcePosition get_position(std::size_t offset) const {
+		const unsigned int line = get_line(offset);
+		return SourcePosition(line, offset - get_line_start(line) + 1);
+	}
+};
@@ -1,15 +1,12 @@
 #include "../parser.hpp"
 #include "../pratt.hpp"
 #include "../printer.hpp"
+#include "../analysis.hpp"
 
 using namespace parser;
 
 constexpr auto white_space = ignore(zero_or_more(' '));
 
-template <class P> static constexpr auto op(P p) {
-	return sequence(white_space, ignore(p), white_space);
-}
-
 constexpr unsigned int add(unsigned int lhs, unsigned int rhs) {
 	return lhs + rhs;
 }
@@ -73,16 +70,17 @@ constexpr auto number = collect<IntCollector>(one_or_more(range('0', '9')));
 
 DECLARE_PARSER(expression)
 DEFINE_PARSER(expression, pratt<IntCollector>(
+	trivia(white_space),
 	pratt_level(
-		infix_ltr<InfixCollector<add>>(op('+')),
-		infix_ltr<InfixCollector<subtract>>(op('-'))
+		infix_ltr<InfixCollector<add>>(ignore('+')),
+		infix_ltr<InfixCollector<subtract>>(ignore('-'))
 	),
 	pratt_level(
-		infix_ltr<InfixCollector<multiply>>(op('*')),
-		infix_ltr<InfixCollector<divide>>(op('/'))
+		infix_ltr<InfixCollector<multiply>>(ignore('*')),
+		infix_ltr<InfixCollector<divide>>(ignore('/'))
 	),
 	pratt_level(
-		prefix<PrefixCollector<negate>>(op('-'))
+		prefix<PrefixCollector<negate>>(ignore('-'))
 	),
 	pratt_level(
 		terminal(choice(
@@ -103,6 +101,8 @@ constexpr auto program = sequence(
 	)
 );
 
+CHECK_PARSER(program)
+
 int main(int argc, const char** argv) {
 	using namespace printer;
 	if (argc > 1) {
@@ -0,0 +1,137 @@
+#include "../parser.hpp"
+#include "../peg.hpp"
+#include "../printer.hpp"
+#include <chrono>
+#include <cstdlib>
+
+// compares a grammar compiled at runtime with peg.hpp to the same grammar written with the combinators
+
+using namespace parser;
+
+constexpr auto spacing = ignore(zero_or_more(' '));
+constexpr auto number = sequence(one_or_more(range('0', '9')), spacing);
+
+DECLARE_PARSER(sum)
+constexpr auto primary = choice(
+	number,
+	sequence('(', spacing, sum, ')', spacing)
+);
+constexpr auto term = sequence(primary, zero_or_more(sequence(one_of("*/"), spacing, primary)));
+DEFINE_PARSER(sum, sequence(term, zero_or_more(sequence(one_of("+-"), spacing, term))))
+
+constexpr auto program = sequence(spacing, sum, end());
+
+constexpr const char* grammar = R"(
+	Program <- _Spacing Sum !.
+	Sum <- Term ([+-] _Spacing Term)*
+	Term <- Primary ([*/] _Spacing Primary)*
+	Primary <- Number / '(' _Spacing Sum ')' _Spacing
+	Number <- [0-9]+ _Spacing
+	_Spacing <- ' '*
+)";
+
+// the same grammar without captures
+constexpr const char* recognizer = R"(
+	_Program <- _Spacing _Sum !.
+	_Sum <- _Term ([+-] _Spacing _Term)*
+	_Term <- _Primary ([*/] _Spacing _Primary)*
+	_Primary <- _Number / '(' _Spacing _Sum ')' _Spacing
+	_Number <- [0-9]+ _Spacing
+	_Spacing <- ' '*
+)";
+
+class Generator {
+	std::string& s;
+	unsigned int state;
+	unsigned int next() {
+		state = state * 1103515245 + 12345;
+		return state >> 16;
+	}
+public:
+	Generator(std::string& s): s(s), state(1) {}
+	void generate_primary(unsigned int depth) {
+		if (depth < 8 && next() % 8 == 0) {
+			s.append("( ");
+			generate(depth + 1);
+			s.append(") ");
+		}
+		else {
+			s.append(std::to_string(next() % 1000));
+			s.push_back(' ');
+		}
+	}
+	void generate(unsigned int depth) {
+		const unsigned int terms = 1 + next() % 4;
+		for (unsigned int i = 0; i < terms; ++i) {
+			if (i > 0) {
+				s.append(next() % 2 ? "+ " : "- ");
+			}
+			generate_primary(depth);
+			while (next() % 3 == 0) {
+				s.append(next() % 2 ? "* " : "/ ");
+				generate_primary(depth);
+			}
+		}
+	}
+};
+
+// the best of several runs in milliseconds
+template <class F> double measure(F&& f) {
+	double best = 0.0;
+	for (unsigned int i = 0; i < 5; ++i) {
+		const auto start = std::chrono::steady_clock::now();
+		if (!f()) {
+			return -1.0;
+		}
+		const double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (i == 0 || time < best) {
+			best = time;
+		}
+	}
+	return best;
+}
+
+PegProgram compile(const char* grammar) {
+	PegProgram program;
+	Context context(grammar);
+	if (compile_peg(context, program) != SUCCESS) {
+		printer::print_error(StringView(), context.get_source(), context.get_location(), context.get_error());
+		std::exit(1);
+	}
+	return program;
+}
+
+int main(int argc, const char** argv) {
+	using namespace printer;
+	const std::size_t size = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16 * 1024 * 1024;
+	std::string source;
+	Generator generator(source);
+	while (source.size() < size) {
+		if (!source.empty()) {
+			source.append("+ ");
+		}
+		generator.generate(0);
+	}
+	const PegProgram peg_program = compile(grammar);
+	const PegProgram peg_recognizer = compile(recognizer);
+	std::size_t captures = 0;
+	const double combinators_time = measure([&]() {
+		parser::Context context(source);
+		return parse_impl(program, context, Ignore()) == SUCCESS;
+	});
+	const double recognizer_time = measure([&]() {
+		parser::Context context(source);
+		return parse_impl(peg(peg_recognizer), context, Ignore()) == SUCCESS;
+	});
+	const double program_time = measure([&]() {
+		parser::Context context(source);
+		PegTree tree;
+		const bool success = parse_impl(peg(peg_program), context, GetValueCallback<PegTree>(tree)) == SUCCESS;
+		captures = tree.captures.size();
+		return success;
+	});
+	print(ln(format("input: % bytes", print_number(source.size()))));
+	print(ln(format("combinators: % ms", print_number(static_cast<unsigned int>(combinators_time)))));
+	print(ln(format("peg without captures: % ms", print_number(static_cast<unsigned int>(recognizer_time)))));
+	print(ln(format("peg with % captures: % ms", print_number(captures), print_number(static_cast<unsigned int>(program_time)))));
+}
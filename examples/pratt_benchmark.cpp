@@ -0,0 +1,200 @@
+#include "../parser.hpp"
+#include "../pratt.hpp"
+#include "../printer.hpp"
+#include <chrono>
+#include <cstdlib>
+
+// compares a Pratt parser whose operators are read from an OperatorTable at runtime to the same parser built at compile time
+
+using namespace parser;
+
+constexpr auto spacing = ignore(zero_or_more(' '));
+
+template <char> class OperatorTag {
+public:
+	constexpr OperatorTag() {}
+};
+
+class IntCollector {
+	unsigned int n;
+public:
+	IntCollector(): n(0) {}
+	void push(char c) {
+		n = n * 10 + (c - '0');
+	}
+	void push(unsigned int n) {
+		this->n = n;
+	}
+	// compile-time operators
+	void push(OperatorTag<'+'>, unsigned int n) {
+		this->n += n;
+	}
+	void push(OperatorTag<'-'>, unsigned int n) {
+		this->n -= n;
+	}
+	void push(OperatorTag<'*'>, unsigned int n) {
+		this->n *= n;
+	}
+	void push(OperatorTag<'/'>, unsigned int n) {
+		this->n = n != 0 ? this->n / n : 0;
+	}
+	void push(OperatorTag<'~'>, unsigned int n) {
+		this->n = -n;
+	}
+	// runtime operators
+	void push(const Operator<char>& op, unsigned int n) {
+		switch (op.value) {
+		case '+':
+			push(OperatorTag<'+'>(), n);
+			break;
+		case '-':
+			push(OperatorTag<'-'>(), n);
+			break;
+		case '*':
+			push(OperatorTag<'*'>(), n);
+			break;
+		case '/':
+			push(OperatorTag<'/'>(), n);
+			break;
+		case '~':
+			push(OperatorTag<'~'>(), n);
+			break;
+		}
+	}
+	// the table has no postfix operators
+	void push(const Operator<char>& op) {}
+	void set_location(const SourceLocation& location) {}
+	template <class C> void retrieve(const C& callback) {
+		callback.push(n);
+	}
+};
+
+template <char c> using OperatorCollector = MapCollector<TagMapper<OperatorTag<c>>, TupleCollector<unsigned int>>;
+
+constexpr auto number = sequence(collect<IntCollector>(one_or_more(range('0', '9'))), spacing);
+
+DECLARE_PARSER(compile_time_expression)
+DEFINE_PARSER(compile_time_expression, pratt<IntCollector>(
+	trivia(spacing),
+	pratt_level(
+		infix_ltr<OperatorCollector<'+'>>(ignore('+')),
+		infix_ltr<OperatorCollector<'-'>>(ignore('-'))
+	),
+	pratt_level(
+		infix_ltr<OperatorCollector<'*'>>(ignore('*')),
+		infix_ltr<OperatorCollector<'/'>>(ignore('/'))
+	),
+	pratt_level(
+		prefix<OperatorCollector<'~'>>(ignore('-'))
+	),
+	pratt_level(
+		terminal(choice(
+			number,
+			sequence(ignore('('), spacing, compile_time_expression, ignore(')'), spacing)
+		))
+	)
+))
+
+OperatorTable<char> operators;
+
+DECLARE_PARSER(runtime_expression)
+DEFINE_PARSER(runtime_expression, runtime_pratt<IntCollector, unsigned int>(
+	operators,
+	trivia(spacing),
+	choice(
+		number,
+		sequence(ignore('('), spacing, runtime_expression, ignore(')'), spacing)
+	)
+))
+
+constexpr auto compile_time_program = sequence(spacing, compile_time_expression, end());
+constexpr auto runtime_program = sequence(spacing, runtime_expression, end());
+
+class Generator {
+	std::string& s;
+	unsigned int state;
+	unsigned int next() {
+		state = state * 1103515245 + 12345;
+		return state >> 16;
+	}
+public:
+	Generator(std::string& s): s(s), state(1) {}
+	void generate_primary(unsigned int depth) {
+		if (next() % 16 == 0) {
+			s.append("- ");
+		}
+		if (depth < 8 && next() % 8 == 0) {
+			s.append("( ");
+			generate(depth + 1);
+			s.append(") ");
+		}
+		else {
+			s.append(std::to_string(next() % 1000));
+			s.push_back(' ');
+		}
+	}
+	void generate(unsigned int depth) {
+		const unsigned int terms = 1 + next() % 4;
+		for (unsigned int i = 0; i < terms; ++i) {
+			if (i > 0) {
+				s.append(next() % 2 ? "+ " : "- ");
+			}
+			generate_primary(depth);
+			while (next() % 3 == 0) {
+				s.append(next() % 2 ? "* " : "/ ");
+				generate_primary(depth);
+			}
+		}
+	}
+};
+
+// the best of several runs in milliseconds
+template <class F> double measure(F&& f) {
+	double best = 0.0;
+	for (unsigned int i = 0; i < 5; ++i) {
+		const auto start = std::chrono::steady_clock::now();
+		if (!f()) {
+			return -1.0;
+		}
+		const double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (i == 0 || time < best) {
+			best = time;
+		}
+	}
+	return best;
+}
+
+int main(int argc, const char** argv) {
+	using namespace printer;
+	const std::size_t size = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16 * 1024 * 1024;
+	std::string source;
+	Generator generator(source);
+	while (source.size() < size) {
+		if (!source.empty()) {
+			source.append("+ ");
+		}
+		generator.generate(0);
+	}
+	operators.add_infix_ltr("+", 1, '+');
+	operators.add_infix_ltr("-", 1, '-');
+	operators.add_infix_ltr("*", 2, '*');
+	operators.add_infix_ltr("/", 2, '/');
+	operators.add_prefix("-", 3, '~');
+	unsigned int compile_time_value = 0;
+	unsigned int runtime_value = 0;
+	const double compile_time_time = measure([&]() {
+		parser::Context context(source);
+		return parse_impl(compile_time_program, context, GetValueCallback<unsigned int>(compile_time_value)) == SUCCESS;
+	});
+	const double runtime_time = measure([&]() {
+		parser::Context context(source);
+		return parse_impl(runtime_program, context, GetValueCallback<unsigned int>(runtime_value)) == SUCCESS;
+	});
+	if (compile_time_value != runtime_value) {
+		print(ln("error: the parsers computed different values"));
+		return 1;
+	}
+	print(ln(format("input: % bytes", print_number(source.size()))));
+	print(ln(format("compile-time pratt: % ms", print_number(static_cast<unsigned int>(compile_time_time)))));
+	print(ln(format("runtime pratt: % ms", print_number(static_cast<unsigned int>(runtime_time)))));
+}
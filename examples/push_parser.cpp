@@ -0,0 +1,131 @@
+#include "../parser.hpp"
+#include "../push.hpp"
+#include "../printer.hpp"
+#include <algorithm>
+#include <memory>
+#include <sys/socket.h>
+#include <poll.h>
+
+// parses requests from many connections on a single thread, feeding each parser whatever a read returns
+// the connections are local socket pairs whose client ends send their requests in small random pieces (POSIX only)
+
+using namespace parser;
+
+class Request {
+public:
+	StringView method;
+	StringView path;
+	std::size_t headers;
+	Request(): headers(0) {}
+};
+
+class RequestCollector {
+	Request request;
+public:
+	void push(const StringView& s) {
+		if (request.method.empty()) {
+			request.method = s;
+		}
+		else if (request.path.empty()) {
+			request.path = s;
+		}
+		else {
+			++request.headers;
+		}
+	}
+	template <class C> void retrieve(const C& callback) {
+		callback.push(std::move(request));
+	}
+};
+
+constexpr auto header = sequence(
+	collect_string(one_or_more(choice(range('a', 'z'), range('A', 'Z'), '-'))),
+	ignore(sequence(':', until("\r\n"), "\r\n"))
+);
+constexpr auto http_request = collect<RequestCollector>(sequence(
+	collect_string(one_or_more(range('A', 'Z'))),
+	ignore(' '),
+	collect_string(until(' ')),
+	ignore(" HTTP/1.1\r\n"),
+	zero_or_more(header),
+	choice(ignore("\r\n"), error("invalid header"))
+));
+
+class Connection {
+public:
+	int client;
+	int server;
+	std::string message;
+	std::size_t sent;
+	Request request;
+	PushParser parser;
+	Connection(int client, int server, const std::string& message): client(client), server(server), message(message), sent(0), parser(4096, http_request, GetValueCallback<Request>(this->request), 64 * 1024) {}
+};
+
+int main(int argc, const char** argv) {
+	using namespace printer;
+	const std::size_t connection_count = 1000;
+	unsigned int state = 1;
+	auto random = [&]() {
+		state = state * 1103515245 + 12345;
+		return state >> 16;
+	};
+	std::vector<std::unique_ptr<Connection>> connections;
+	for (std::size_t i = 0; i < connection_count; ++i) {
+		int fds[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+			print_error(StringView("socketpair failed"));
+			return 1;
+		}
+		std::string message = i % 2 ? "GET /index.html HTTP/1.1\r\n" : "POST /upload HTTP/1.1\r\n";
+		for (unsigned int j = random() % 8; j > 0; --j) {
+			message.append("X-Header: value\r\n");
+		}
+		message.append("\r\n");
+		connections.emplace_back(new Connection(fds[0], fds[1], message));
+	}
+	std::size_t done = 0;
+	std::size_t success = 0;
+	std::size_t headers = 0;
+	std::vector<pollfd> fds;
+	char buffer[256];
+	while (done < connections.size()) {
+		// the clients send a piece of their request
+		for (auto& connection: connections) {
+			if (connection->sent < connection->message.size()) {
+				const std::size_t size = std::min<std::size_t>(1 + random() % 8, connection->message.size() - connection->sent);
+				connection->sent += write(connection->client, connection->message.data() + connection->sent, size);
+			}
+		}
+		fds.clear();
+		for (auto& connection: connections) {
+			if (connection->parser.get_result() == INCOMPLETE) {
+				fds.push_back({connection->server, POLLIN, 0});
+			}
+		}
+		poll(fds.data(), fds.size(), 0);
+		std::size_t i = 0;
+		for (auto& connection: connections) {
+			if (connection->parser.get_result() != INCOMPLETE) {
+				continue;
+			}
+			if (fds[i].revents & POLLIN) {
+				const ssize_t size = read(connection->server, buffer, sizeof(buffer));
+				const Result result = size > 0 ? connection->parser.feed(StringView(buffer, size)) : connection->parser.finish();
+				if (result != INCOMPLETE) {
+					++done;
+					if (result == SUCCESS) {
+						++success;
+						headers += connection->request.headers;
+					}
+				}
+			}
+			++i;
+		}
+	}
+	print(ln(format("% of % requests parsed, % headers", print_number(success), print_number(connections.size()), print_number(headers))));
+	for (auto& connection: connections) {
+		close(connection->client);
+		close(connection->server);
+	}
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include "parser.hpp"
+#include "analysis.hpp"
+#include "structural.hpp"
+
+namespace parser {
+
+// string literals and comments in which brackets are not counted
+class Delimiters {
+public:
+	// each of these characters starts and ends a string literal
+	StringView quotes;
+	// escapes the next character within a string literal
+	char escape;
+	StringView line_comment;
+	StringView block_comment_begin;
+	StringView block_comment_end;
+	constexpr Delimiters(const StringView& quotes, char escape, const StringView& line_comment, const StringView& block_comment_begin, const StringView& block_comment_end): quotes(quotes), escape(escape), line_comment(line_comment), block_comment_begin(block_comment_begin), block_comment_end(block_comment_end) {}
+};
+
+constexpr Delimiters c_delimiters() {
+	return Delimiters("\"'", '\\', "//", "/*", "*/");
+}
+constexpr Delimiters no_delimiters() {
+	return Delimiters("", '\0', "", "", "");
+}
+
+// returns the position after the closing quote or nullptr if the string literal is not terminated
+inline const char* skip_string(const char* position, const char* end, char quote, char escape) {
+	CharFinder finder;
+	finder.insert(quote);
+	finder.insert(escape);
+	while (true) {
+		position = finder.find(position, end);
+		if (position == end) {
+			return nullptr;
+		}
+		if (*position == quote) {
+			return position + 1;
+		}
+		// escape
+		if (end - position < 2) {
+			return nullptr;
+		}
+		position += 2;
+	}
+}
+
+// returns the position after the end of the block comment or nullptr if it is not terminated
+inline const char* skip_block_comment(const char* position, const char* end, const StringView& comment_end) {
+	position = find_string(position, end, comment_end);
+	return position == end ? nullptr : position + comment_end.size();
+}
+
+// returns the position of the close bracket that matches an open bracket right before position or nullptr if there is none
+inline const char* skip_balanced(const char* position, const char* end, char open, char close, const Delimiters& delimiters) {
+	CharFinder finder;
+	bool use_finder = finder.insert(open) && finder.insert(close);
+	for (char quote: delimiters.quotes) {
+		use_finder = use_finder && finder.insert(quote);
+	}
+	if (!delimiters.line_comment.empty()) {
+		use_finder = use_finder && finder.insert(delimiters.line_comment[0]);
+	}
+	if (!delimiters.block_comment_begin.empty()) {
+		use_finder = use_finder && finder.insert(delimiters.block_comment_begin[0]);
+	}
+	// too many characters for CharFinder
+	auto is_delimiter = [&](char c) {
+		return c == open || c == close || delimiters.quotes.contains(c) || (!delimiters.line_comment.empty() && c == delimiters.line_comment[0]) || (!delimiters.block_comment_begin.empty() && c == delimiters.block_comment_begin[0]);
+	};
+	std::size_t depth = 1;
+	while (true) {
+		if (use_finder) {
+			position = finder.find(position, end);
+		}
+		else {
+			while (position != end && !is_delimiter(*position)) {
+				++position;
+			}
+		}
+		if (position == end) {
+			return nullptr;
+		}
+		const StringView rest(position, end - position);
+		if (*position == close) {
+			--depth;
+			if (depth == 0) {
+				return position;
+			}
+			++position;
+		}
+		else if (*position == open) {
+			++depth;
+			++position;
+		}
+		else if (delimiters.quotes.contains(*position)) {
+			position = skip_string(position + 1, end, *position, delimiters.escape);
+			if (position == nullptr) {
+				return nullptr;
+			}
+		}
+		else if (!delimiters.line_comment.empty() && rest.starts_with(delimiters.line_comment)) {
+			position = static_cast<const char*>(std::memchr(position, '\n', end - position));
+			if (position == nullptr) {
+				return nullptr;
+			}
+		}
+		else if (!delimiters.block_comment_begin.empty() && rest.starts_with(delimiters.block_comment_begin)) {
+			position = skip_block_comment(position + delimiters.block_comment_begin.size(), end, delimiters.block_comment_end);
+			if (position == nullptr) {
+				return nullptr;
+			}
+		}
+		else {
+			++position;
+		}
+	}
+}
+
+// the same using a structural index that contains open and close and recognizes the same string literals
+inline const char* skip_balanced(const StructuralIndex& index, const char* position, const char* end, char open, char close) {
+	const char* source = index.get_source().data();
+	std::size_t depth = 1;
+	for (std::size_t i = index.lower_bound(position - source); i < index.size() && source + index[i] < end; ++i) {
+		const char c = source[index[i]];
+		if (c == close) {
+			--depth;
+			if (depth == 0) {
+				return source + index[i];
+			}
+		}
+		else if (c == open) {
+			++depth;
+		}
+	}
+	return nullptr;
+}
+inline bool can_skip_balanced(const StructuralIndex* index, const StringView& source, char open, char close, const Delimiters& delimiters) {
+	return index && index->get_source().data() == source.data() && index->is_structural(open) && index->is_structural(close) && delimiters.line_comment.empty() && delimiters.block_comment_begin.empty() && (delimiters.quotes.empty() ? index->has_strings('\0', '\0') : delimiters.quotes.size() == 1 && index->has_strings(delimiters.quotes[0], delimiters.escape));
+}
+
+// the result of lazy(); the skipped region is parsed when its value is first accessed and the result is kept
+template <class T> class Lazy {
+	const void* parser;
+	Result (*parse_region)(const void* parser, Context& context, T& value);
+	StringView source;
+	SourceLocation location;
+	ContextLimits limits;
+	bool parsed;
+	Result result;
+	T value;
+	std::string error;
+public:
+	Lazy(): parser(nullptr), parse_region(nullptr), parsed(true), result(FAILURE), value() {}
+	Lazy(const void* parser, Result (*parse_region)(const void*, Context&, T&), const StringView& source, const SourceLocation& location, const ContextLimits& limits): parser(parser), parse_region(parse_region), source(source), location(location), limits(limits), parsed(false), result(FAILURE), value() {}
+	// the location of the region between the brackets
+	const SourceLocation& get_location() const {
+		return location;
+	}
+	StringView get_string() const {
+		return source.substr(location.begin, location.end - location.begin);
+	}
+	bool is_parsed() const {
+		return parsed;
+	}
+	Result parse() {
+		if (!parsed) {
+			// the region is parsed with the limits that remained when it was skipped
+			Context context(source, location);
+			context.set_limits(limits);
+			result = parse_region(parser, context, value);
+			if (result == ERROR) {
+				error = context.get_error().to_string();
+			}
+			parsed = true;
+		}
+		return result;
+	}
+	// nullptr if the region could not be parsed
+	T* get() {
+		return parse() == SUCCESS ? &value : nullptr;
+	}
+	StringView get_error() const {
+		return StringView(error);
+	}
+};
+
+// the handles refer to the lazy() parser, so it has to outlive them (like a grammar defined with DEFINE_PARSER)
+template <class T, class P> class Lazy_ {
+public:
+	char open;
+	char close;
+	Delimiters delimiters;
+	P p;
+	constexpr Lazy_(char open, char close, const Delimiters& delimiters, P p): open(open), close(close), delimiters(delimiters), p(p) {}
+	static Result parse_region(const void* lazy, Context& context, T& value) {
+		const Result result = parse_impl(static_cast<const Lazy_*>(lazy)->p, context, GetValueCallback<T>(value));
+		if (result == SUCCESS && context.has_input()) {
+			// the region was not parsed completely
+			return FAILURE;
+		}
+		return result;
+	}
+};
+
+// skips a balanced region from open to close and parses it with p only when the value is accessed
+template <class T, class P> constexpr Lazy_<T, P> lazy(char open, char close, P p) {
+	return Lazy_<T, P>(open, close, c_delimiters(), p);
+}
+template <class T, class P> constexpr Lazy_<T, P> lazy(char open, char close, const Delimiters& delimiters, P p) {
+	return Lazy_<T, P>(open, close, delimiters, p);
+}
+
+template <class T, class P, class C> Result parse_impl(const Lazy_<T, P>& p, Context& context, const C& callback) {
+	if (!(context.has_input() && *context == p.open)) {
+		return FAILURE;
+	}
+	if (context.is_segmented()) {
+		context.set_error(StringView("lazy() requires contiguous input"));
+		return ERROR;
+	}
+	const SavePoint begin = context.save() + 1;
+	StringView source = context.get_source();
+	const StructuralIndex* index = context.get_structural_index();
+	const char* end = can_skip_balanced(index, source, p.open, p.close, p.delimiters) ? skip_balanced(*index, begin, source.end(), p.open, p.close) : skip_balanced(begin, source.end(), p.open, p.close, p.delimiters);
+	// in push mode the region is skipped again when more input arrives
+	while (end == nullptr && context.wait_for_input()) {
+		source = context.get_source();
+		end = skip_balanced(begin, source.end(), p.open, p.close, p.delimiters);
+	}
+	if (end == nullptr) {
+		return FAILURE;
+	}
+	callback.push(Lazy<T>(&p, &Lazy_<T, P>::parse_region, source, SourceLocation(begin - source.begin(), end - source.begin()), context.get_limits()));
+	context.restore(end + 1);
+	return SUCCESS;
+}
+
+template <class T, class P, class V> constexpr GrammarInfo analyze_impl(const Lazy_<T, P>& p, V) {
+	return GrammarInfo(false, CharSet(p.open), 2, GrammarInfo::UNBOUNDED);
+}
+
+}
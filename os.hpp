@@ -13,6 +13,7 @@
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <sys/wait.h>
+#include <ucontext.h>
 #endif
 
 class Path {
@@ -286,22 +287,38 @@ public:
 class BufferedOutput: public Output {
 	static constexpr std::size_t BUFFER_SIZE = 8192;
 	Output& output;
-	char buffer[BUFFER_SIZE];
+	char* buffer;
+	std::size_t buffer_size;
 	std::size_t i;
+	char storage[BUFFER_SIZE];
+	// a buffer of the caller is written only once, whatever does not fit is passed on to output
+	bool is_external() const {
+		return buffer != storage;
+	}
 public:
-	BufferedOutput(Output& output): output(output), i(0) {}
+	BufferedOutput(Output& output): output(output), buffer(storage), buffer_size(BUFFER_SIZE), i(0) {}
+	// writes directly into the memory of the caller
+	BufferedOutput(Output& output, char* buffer, std::size_t buffer_size): output(output), buffer(buffer), buffer_size(buffer_size), i(0) {}
 	BufferedOutput(const BufferedOutput&) = delete;
 	~BufferedOutput() {
-		output.write(buffer, i);
+		if (!is_external()) {
+			output.write(buffer, i);
+		}
 	}
 	BufferedOutput& operator =(const BufferedOutput&) = delete;
 	void write(const char* data, std::size_t size) override {
-		const std::size_t capacity = BUFFER_SIZE - i;
+		const std::size_t capacity = buffer_size - i;
 		if (size < capacity) {
 			std::memcpy(buffer + i, data, size);
 			i += size;
 			return;
 		}
+		if (is_external()) {
+			std::memcpy(buffer + i, data, capacity);
+			i = buffer_size;
+			output.write(data + capacity, size - capacity);
+			return;
+		}
 		if (i > 0) {
 			std::memcpy(buffer + i, data, capacity);
 			data += capacity;
@@ -318,11 +335,49 @@ public:
 		}
 	}
 	void write(char c) {
+		if (i + 1 < buffer_size) {
+			buffer[i] = c;
+			++i;
+			return;
+		}
 		write(&c, 1);
 	}
+	// writes c count times
+	void fill(char c, std::size_t count) {
+		while (count > 0) {
+			if (i + 1 >= buffer_size) {
+				if (is_external()) {
+					if (i < buffer_size) {
+						buffer[i] = c;
+						++i;
+						--count;
+					}
+					while (count > 0) {
+						const std::size_t size = std::min(count, sizeof(storage));
+						std::memset(storage, c, size);
+						output.write(storage, size);
+						count -= size;
+					}
+					return;
+				}
+				output.write(buffer, i);
+				i = 0;
+			}
+			const std::size_t size = std::min(count, buffer_size - 1 - i);
+			std::memset(buffer + i, c, size);
+			i += size;
+			count -= size;
+		}
+	}
 	void flush() {
-		output.write(buffer, i);
-		i = 0;
+		if (!is_external()) {
+			output.write(buffer, i);
+			i = 0;
+		}
+	}
+	// the number of characters in the buffer of the caller
+	std::size_t get_size() const {
+		return i;
 	}
 };
 
@@ -347,6 +402,19 @@ public:
 	}
 };
 
+// discards everything and only counts the characters
+class CountingOutput: public Output {
+	std::size_t count;
+public:
+	CountingOutput(): count(0) {}
+	void write(const char* data, std::size_t size) override {
+		count += size;
+	}
+	std::size_t get_count() const {
+		return count;
+	}
+};
+
 class ReadFile: public Input {
 	#ifdef _WIN32
 	#else
@@ -505,11 +573,99 @@ public:
 	}
 };
 
+// the number of zero bytes that follow a padded input, enough for a vector load that begins before the end
+constexpr std::size_t INPUT_PADDING = 64;
+
+// the input of a MemoryMappedFile is padded with zero bytes if possible, see is_padded()
+// files that cannot be mapped, for example pipes and files in /proc, are read into memory instead
 class MemoryMappedFile {
 	void* address;
 	std::size_t size_;
+	bool padded;
+	#ifndef _WIN32
+	std::size_t mapped_size;
+	// the input was read into memory from malloc()
+	bool copied;
+	// the pages before released have been dropped by release()
+	char* released;
+	bool map(int fd, unsigned int flags) {
+		// the file is mapped over a larger anonymous mapping whose remaining pages are zero
+		const std::size_t page_size = sysconf(_SC_PAGESIZE);
+		mapped_size = (size_ + INPUT_PADDING + page_size - 1) / page_size * page_size;
+		void* reserved = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (reserved == MAP_FAILED) {
+			return false;
+		}
+		int map_flags = MAP_PRIVATE | MAP_FIXED;
+		#ifdef MAP_POPULATE
+		if (flags & POPULATE) {
+			map_flags |= MAP_POPULATE;
+		}
+		#endif
+		if (mmap(reserved, size_, PROT_READ, map_flags, fd, 0) == MAP_FAILED) {
+			munmap(reserved, mapped_size);
+			return false;
+		}
+		address = reserved;
+		released = static_cast<char*>(reserved);
+		if (flags & SEQUENTIAL) {
+			madvise(address, size_, MADV_SEQUENTIAL);
+		}
+		if (flags & WILL_NEED) {
+			madvise(address, size_, MADV_WILLNEED);
+		}
+		#ifdef MADV_HUGEPAGE
+		if (flags & HUGE_PAGES) {
+			madvise(address, size_, MADV_HUGEPAGE);
+		}
+		#endif
+		return true;
+	}
+	bool read_all(int fd) {
+		// the size of a regular file is only a hint, the file can change while it is read
+		std::size_t capacity = size_ > 0 ? size_ : 64 * 1024;
+		char* data = static_cast<char*>(std::malloc(capacity + INPUT_PADDING));
+		size_ = 0;
+		while (data) {
+			if (size_ == capacity) {
+				capacity *= 2;
+				char* new_data = static_cast<char*>(std::realloc(data, capacity + INPUT_PADDING));
+				if (new_data == nullptr) {
+					break;
+				}
+				data = new_data;
+			}
+			const ssize_t result = ::read(fd, data + size_, capacity - size_);
+			if (result == -1) {
+				if (errno == EINTR) {
+					continue;
+				}
+				break;
+			}
+			if (result == 0) {
+				std::memset(data + size_, 0, INPUT_PADDING);
+				address = data;
+				copied = true;
+				return true;
+			}
+			size_ += result;
+		}
+		std::free(data);
+		size_ = 0;
+		return false;
+	}
+	#endif
 public:
-	MemoryMappedFile(const char* path) {
+	// hints for the kernel about how the file is accessed, they can be combined and are ignored if they are not supported
+	// the file is parsed from the beginning to the end, so the kernel can read ahead more aggressively
+	static constexpr unsigned int SEQUENTIAL = 1 << 0;
+	// the kernel starts to read the whole file in the background
+	static constexpr unsigned int WILL_NEED = 1 << 1;
+	// the whole file is read before the constructor returns, so the parse does not stall on page faults
+	static constexpr unsigned int POPULATE = 1 << 2;
+	// transparent huge pages, where the file system supports them
+	static constexpr unsigned int HUGE_PAGES = 1 << 3;
+	MemoryMappedFile(const char* path, unsigned int flags = 0): padded(false) {
 		#ifdef _WIN32
 		HANDLE file = CreateFile(path, GENERIC_READ, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
 		LARGE_INTEGER large_integer;
@@ -519,32 +675,49 @@ public:
 		address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size_);
 		CloseHandle(mapping);
 		CloseHandle(file);
+		// the rest of the last page is zero
+		SYSTEM_INFO system_info;
+		GetSystemInfo(&system_info);
+		padded = address && size_ % system_info.dwPageSize != 0 && system_info.dwPageSize - size_ % system_info.dwPageSize >= INPUT_PADDING;
 		#else
-		const int fd = open(path, O_RDONLY);
+		address = nullptr;
+		size_ = 0;
+		mapped_size = 0;
+		copied = false;
+		released = nullptr;
+		const int fd = open(path, O_RDONLY | O_CLOEXEC);
 		if (fd == -1) {
-			address = nullptr;
-			size_ = 0;
 			return;
 		}
 		struct stat s;
-		fstat(fd, &s);
-		size_ = s.st_size;
-		address = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
-		if (address == MAP_FAILED) {
-			address = nullptr;
-			size_ = 0;
+		if (fstat(fd, &s) == 0 && S_ISREG(s.st_mode)) {
+			size_ = s.st_size;
 		}
+		// files in /proc report a size of 0
+		if (size_ == 0 || !map(fd, flags)) {
+			read_all(fd);
+		}
+		padded = address != nullptr;
 		close(fd);
 		#endif
 	}
-	MemoryMappedFile(): address(nullptr), size_(0) {}
+	MemoryMappedFile(): address(nullptr), size_(0), padded(false) {
+		#ifndef _WIN32
+		mapped_size = 0;
+		copied = false;
+		released = nullptr;
+		#endif
+	}
 	MemoryMappedFile(const MemoryMappedFile&) = delete;
 	~MemoryMappedFile() {
 		#ifdef _WIN32
 		UnmapViewOfFile(address);
 		#else
-		if (address) {
-			munmap(address, size_);
+		if (copied) {
+			std::free(address);
+		}
+		else if (address) {
+			munmap(address, mapped_size);
 		}
 		#endif
 	}
@@ -552,6 +725,25 @@ public:
 	explicit operator bool() const {
 		return address != nullptr;
 	}
+	// whether INPUT_PADDING zero bytes can be read after the end
+	bool is_padded() const {
+		return padded;
+	}
+	// drops the pages before position from memory, so the memory use stays flat while a large file is parsed from the beginning to the end
+	// the input before position should not be accessed anymore, otherwise it is read from the file again
+	void release(const char* position) {
+		#ifndef _WIN32
+		if (address == nullptr || copied) {
+			return;
+		}
+		const std::size_t page_size = sysconf(_SC_PAGESIZE);
+		char* end = static_cast<char*>(address) + (position - begin()) / page_size * page_size;
+		if (released < end) {
+			madvise(released, end - released, MADV_DONTNEED);
+			released = end;
+		}
+		#endif
+	}
 	const char* data() const {
 		return static_cast<char*>(address);
 	}
@@ -569,6 +761,217 @@ public:
 	}
 };
 
+// a copy of an input in memory that is followed by INPUT_PADDING zero bytes
+class PaddedBuffer {
+	char* data_;
+	std::size_t size_;
+public:
+	PaddedBuffer(const StringView& s): data_(new char[s.size() + INPUT_PADDING]), size_(s.size()) {
+		std::memcpy(data_, s.data(), size_);
+		std::memset(data_ + size_, 0, INPUT_PADDING);
+	}
+	PaddedBuffer(const PaddedBuffer&) = delete;
+	~PaddedBuffer() {
+		delete[] data_;
+	}
+	PaddedBuffer& operator =(const PaddedBuffer&) = delete;
+	const char* data() const {
+		return data_;
+	}
+	std::size_t size() const {
+		return size_;
+	}
+	char operator [](std::size_t i) const {
+		return data_[i];
+	}
+	const char* begin() const {
+		return data_;
+	}
+	const char* end() const {
+		return data_ + size_;
+	}
+};
+
+// a separately allocated stack for deeply recursive code; the memory is only committed as it is used
+class Stack {
+	void* address;
+	std::size_t size_;
+	#ifdef _WIN32
+	template <class F> class Data {
+	public:
+		F& f;
+		void* caller;
+		Data(F& f, void* caller): f(f), caller(caller) {}
+	};
+	template <class F> static void CALLBACK entry(void* data_) {
+		Data<F>* data = static_cast<Data<F>*>(data_);
+		data->f();
+		SwitchToFiber(data->caller);
+	}
+	#else
+	template <class F> static void entry(unsigned int high, unsigned int low) {
+		F& f = *reinterpret_cast<F*>(static_cast<std::uintptr_t>(static_cast<std::uint64_t>(high) << 32 | low));
+		f();
+	}
+	#endif
+public:
+	Stack(std::size_t size): size_(size) {
+		#ifdef _WIN32
+		address = nullptr;
+		#else
+		address = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+		if (address == MAP_FAILED) {
+			address = nullptr;
+			size_ = 0;
+			return;
+		}
+		// guard page
+		mprotect(address, sysconf(_SC_PAGESIZE), PROT_NONE);
+		#endif
+	}
+	Stack(const Stack&) = delete;
+	~Stack() {
+		#ifdef _WIN32
+		#else
+		if (address) {
+			munmap(address, size_);
+		}
+		#endif
+	}
+	Stack& operator =(const Stack&) = delete;
+	void* data() const {
+		return address;
+	}
+	std::size_t size() const {
+		return size_;
+	}
+	template <class F> void run(F&& f) {
+		#ifdef _WIN32
+		const bool is_fiber = IsThreadAFiber();
+		void* caller = is_fiber ? GetCurrentFiber() : ConvertThreadToFiber(nullptr);
+		Data<F> data(f, caller);
+		void* fiber = CreateFiber(size_, &entry<F>, &data);
+		if (fiber == nullptr) {
+			if (!is_fiber) {
+				ConvertFiberToThread();
+			}
+			f();
+			return;
+		}
+		SwitchToFiber(fiber);
+		DeleteFiber(fiber);
+		if (!is_fiber) {
+			ConvertFiberToThread();
+		}
+		#else
+		if (address == nullptr) {
+			f();
+			return;
+		}
+		ucontext_t caller;
+		ucontext_t callee;
+		getcontext(&callee);
+		callee.uc_stack.ss_sp = address;
+		callee.uc_stack.ss_size = size_;
+		callee.uc_link = &caller;
+		const std::uint64_t pointer = reinterpret_cast<std::uintptr_t>(&f);
+		makecontext(&callee, reinterpret_cast<void (*)()>(&entry<typename std::remove_reference<F>::type>), 2, static_cast<unsigned int>(pointer >> 32), static_cast<unsigned int>(pointer));
+		swapcontext(&caller, &callee);
+		#endif
+	}
+};
+
+// a function that runs on its own stack and can suspend itself until it is resumed
+class Coroutine {
+	Stack stack;
+	void (*function)(void*);
+	void* data;
+	bool started;
+	bool done;
+	#ifdef _WIN32
+	void* fiber;
+	void* caller;
+	static void CALLBACK entry(void* coroutine_) {
+		Coroutine* coroutine = static_cast<Coroutine*>(coroutine_);
+		coroutine->function(coroutine->data);
+		coroutine->done = true;
+		SwitchToFiber(coroutine->caller);
+	}
+	#else
+	ucontext_t caller;
+	ucontext_t callee;
+	static void entry(unsigned int high, unsigned int low) {
+		Coroutine* coroutine = reinterpret_cast<Coroutine*>(static_cast<std::uintptr_t>(static_cast<std::uint64_t>(high) << 32 | low));
+		coroutine->function(coroutine->data);
+		coroutine->done = true;
+		// returns to the caller through uc_link
+	}
+	#endif
+public:
+	Coroutine(std::size_t stack_size, void (*function)(void*), void* data): stack(stack_size), function(function), data(data), started(false), done(false) {
+		#ifdef _WIN32
+		fiber = nullptr;
+		caller = nullptr;
+		#endif
+	}
+	Coroutine(const Coroutine&) = delete;
+	~Coroutine() {
+		#ifdef _WIN32
+		if (fiber) {
+			DeleteFiber(fiber);
+		}
+		#endif
+	}
+	Coroutine& operator =(const Coroutine&) = delete;
+	bool is_started() const {
+		return started;
+	}
+	bool is_done() const {
+		return done;
+	}
+	// runs the function until it suspends itself or returns; returns false if the stack could not be allocated
+	bool resume() {
+		#ifdef _WIN32
+		if (!started) {
+			fiber = CreateFiber(stack.size(), &entry, this);
+			if (fiber == nullptr) {
+				return false;
+			}
+			started = true;
+		}
+		const bool is_fiber = IsThreadAFiber();
+		caller = is_fiber ? GetCurrentFiber() : ConvertThreadToFiber(nullptr);
+		SwitchToFiber(fiber);
+		if (!is_fiber) {
+			ConvertFiberToThread();
+		}
+		#else
+		if (!started) {
+			if (stack.data() == nullptr) {
+				return false;
+			}
+			getcontext(&callee);
+			callee.uc_stack.ss_sp = stack.data();
+			callee.uc_stack.ss_size = stack.size();
+			callee.uc_link = &caller;
+			const std::uint64_t pointer = reinterpret_cast<std::uintptr_t>(this);
+			makecontext(&callee, reinterpret_cast<void (*)()>(&entry), 2, static_cast<unsigned int>(pointer >> 32), static_cast<unsigned int>(pointer));
+			started = true;
+		}
+		swapcontext(&caller, &callee);
+		#endif
+		return true;
+	}
+	// called by the function to return to the caller of resume()
+	void suspend() {
+		#ifdef _WIN32
+		SwitchToFiber(caller);
+		#else
+		swapcontext(&callee, &caller);
+		#endif
+	}
+};
+
 class StandardInput {
 public:
 	static BufferedInput& get() {
@@ -2,6 +2,12 @@
 
 #include "common.hpp"
 #include "printer.hpp"
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
 
 #define DECLARE_PARSER(name) struct name##_t; constexpr parser::Reference_<name##_t> name;
 #define DEFINE_PARSER(name, ...) struct name##_t { static constexpr auto parser = __VA_ARGS__; }; constexpr decltype(name##_t::parser) name##_t::parser;
@@ -10,19 +16,270 @@ namespace parser {
 
 using SavePoint = const char*;
 
+class StructuralIndex;
+
+// input that arrives in parts, see push.hpp
+class PushInput {
+public:
+	virtual ~PushInput() {}
+	// waits until more input has arrived and returns its new end, or nullptr if no more input will arrive
+	virtual const char* wait_for_input() = 0;
+};
+
+// input that consists of segments that are not contiguous in memory, for example the buffers of a scatter-gather read or the pieces of a piece table
+class SegmentedInput {
+public:
+	class Segment {
+	public:
+		const char* begin;
+		const char* end;
+		// the offset of the segment within the input
+		std::size_t offset;
+		Segment(const char* begin, const char* end, std::size_t offset): begin(begin), end(end), offset(offset) {}
+	};
+private:
+	std::vector<Segment> segments;
+	// the indices of the segments in the order of their addresses
+	std::vector<std::size_t> addresses;
+	std::vector<std::unique_ptr<char[]>> copies;
+	// the copies made by copy() by their offset and size, so that a string that is retrieved again after backtracking is not copied again
+	std::map<std::pair<std::size_t, std::size_t>, const char*> copy_index;
+	std::size_t size_;
+	// the contiguous copy of the whole input made by get_source()
+	const char* source;
+	const char* make_copy(const char* begin, std::size_t size) {
+		// the copy is surrounded by a byte on each side so that it does not touch any other segment
+		copies.emplace_back(new char[size + 2]);
+		std::memcpy(copies.back().get() + 1, begin, size);
+		return copies.back().get() + 1;
+	}
+	bool compare_addresses(std::size_t lhs, std::size_t rhs) const {
+		return std::less<const char*>()(segments[lhs].begin, segments[rhs].begin);
+	}
+	void sort_addresses() {
+		addresses.clear();
+		for (std::size_t i = 0; i < segments.size(); ++i) {
+			addresses.push_back(i);
+		}
+		std::sort(addresses.begin(), addresses.end(), [this](std::size_t lhs, std::size_t rhs) {
+			return compare_addresses(lhs, rhs);
+		});
+	}
+public:
+	SegmentedInput(const std::vector<StringView>& views): size_(0), source(nullptr) {
+		for (const StringView& view: views) {
+			if (view.empty()) {
+				continue;
+			}
+			if (!segments.empty() && segments.back().end == view.begin()) {
+				// contiguous in memory
+				segments.back().end = view.end();
+			}
+			else {
+				segments.emplace_back(view.begin(), view.end(), size_);
+			}
+			size_ += view.size();
+		}
+		// a position is identified by its address, so segments that touch or overlap another segment in memory are copied
+		sort_addresses();
+		bool copied = false;
+		const char* last_end = nullptr;
+		for (std::size_t i: addresses) {
+			Segment& segment = segments[i];
+			if (last_end && !std::less<const char*>()(last_end, segment.begin)) {
+				const char* begin = make_copy(segment.begin, segment.end - segment.begin);
+				segment.end = begin + (segment.end - segment.begin);
+				segment.begin = begin;
+				copied = true;
+			}
+			else {
+				last_end = segment.end;
+			}
+		}
+		if (copied) {
+			sort_addresses();
+		}
+	}
+	SegmentedInput(const SegmentedInput&) = delete;
+	SegmentedInput& operator =(const SegmentedInput&) = delete;
+	std::size_t size() const {
+		return size_;
+	}
+	std::size_t get_segment_count() const {
+		return segments.size();
+	}
+	const Segment& get_segment(std::size_t i) const {
+		return segments[i];
+	}
+	// the index of the segment that contains position, including its end
+	std::size_t find(const char* position) const {
+		auto i = std::upper_bound(addresses.begin(), addresses.end(), position, [this](const char* position, std::size_t segment) {
+			return std::less<const char*>()(position, segments[segment].begin);
+		});
+		return *(i - 1);
+	}
+	std::size_t get_offset(const char* position) const {
+		const Segment& segment = segments[find(position)];
+		return segment.offset + (position - segment.begin);
+	}
+	// a contiguous copy of the input from begin to end, which can be in different segments; it lives as long as the input
+	StringView copy(const char* begin, const char* end) {
+		std::size_t i = find(begin);
+		const std::size_t offset = segments[i].offset + (begin - segments[i].begin);
+		const std::size_t size = get_offset(end) - offset;
+		if (source) {
+			return StringView(source + offset, size);
+		}
+		auto result = copy_index.emplace(std::make_pair(offset, size), nullptr);
+		if (!result.second) {
+			return StringView(result.first->second, size);
+		}
+		copies.emplace_back(new char[size + 1]);
+		result.first->second = copies.back().get();
+		char* destination = copies.back().get();
+		std::size_t remaining = size;
+		while (true) {
+			const std::size_t n = std::min<std::size_t>(remaining, segments[i].end - begin);
+			std::memcpy(destination, begin, n);
+			destination += n;
+			remaining -= n;
+			if (remaining == 0) {
+				break;
+			}
+			++i;
+			begin = segments[i].begin;
+		}
+		return StringView(copies.back().get(), size);
+	}
+	// a contiguous copy of the whole input, made on the first call; the offsets within the input are offsets within the copy
+	StringView get_source() {
+		if (source == nullptr && size_ > 0) {
+			copies.emplace_back(new char[size_]);
+			for (const Segment& segment: segments) {
+				std::memcpy(copies.back().get() + segment.offset, segment.begin, segment.end - segment.begin);
+			}
+			source = copies.back().get();
+		}
+		return StringView(source, size_);
+	}
+};
+
+// the limits of a context and its structural index, to parse a part of the same source later or on another thread
+class ContextLimits {
+public:
+	std::size_t max_depth;
+	std::size_t max_steps;
+	bool has_deadline;
+	std::chrono::steady_clock::time_point deadline;
+	const std::atomic<bool>* cancelled;
+	const StructuralIndex* structural_index;
+	ContextLimits(): max_depth(-1), max_steps(-1), has_deadline(false), cancelled(nullptr), structural_index(nullptr) {}
+};
+
 class Context {
 	const char* position;
 	const char* end;
+	// the beginning of the source or of the current segment
 	const char* begin;
+	std::size_t begin_offset;
+	SegmentedInput* segmented_input;
+	std::size_t segment;
 	std::string error;
+	std::size_t depth;
+	std::size_t max_depth;
+	// the limits are only checked when countdown reaches zero, after at most CHECK_INTERVAL steps
+	static constexpr std::size_t CHECK_INTERVAL = 1024;
+	std::size_t countdown;
+	std::size_t interval;
+	std::size_t steps;
+	std::size_t max_steps;
+	bool has_deadline;
+	std::chrono::steady_clock::time_point deadline;
+	const std::atomic<bool>* cancelled;
+	bool aborted;
+	const StructuralIndex* structural_index;
+	PushInput* push_input;
+	// INPUT_PADDING zero bytes follow the end
+	bool padded;
+	void reset_countdown() {
+		if (max_steps == std::size_t(-1) && !has_deadline && cancelled == nullptr) {
+			interval = -1;
+		}
+		else {
+			const std::size_t remaining = steps < max_steps ? max_steps - steps : 0;
+			interval = remaining < CHECK_INTERVAL ? remaining + 1 : CHECK_INTERVAL;
+		}
+		countdown = interval;
+	}
+	bool check_limits() {
+		steps += interval;
+		if (steps > max_steps) {
+			return abort(StringView("step budget exceeded"));
+		}
+		if (cancelled && cancelled->load(std::memory_order_relaxed)) {
+			return abort(StringView("parse cancelled"));
+		}
+		if (has_deadline && std::chrono::steady_clock::now() >= deadline) {
+			return abort(StringView("deadline exceeded"));
+		}
+		reset_countdown();
+		return true;
+	}
+	bool abort(const StringView& reason) {
+		set_error(reason);
+		aborted = true;
+		return false;
+	}
+	PARSER_NOINLINE void find_segment(const char* position) {
+		enter_segment(segmented_input->find(position));
+	}
+	void enter_segment(std::size_t segment) {
+		const SegmentedInput::Segment& s = segmented_input->get_segment(segment);
+		this->segment = segment;
+		begin = s.begin;
+		end = s.end;
+		begin_offset = s.offset;
+	}
 public:
-	Context(const StringView& s): position(s.begin()), end(s.end()), begin(s.begin()) {}
+	Context(const StringView& s): position(s.begin()), end(s.end()), begin(s.begin()), begin_offset(0), segmented_input(nullptr), segment(0), depth(0), max_depth(-1), countdown(-1), interval(-1), steps(0), max_steps(-1), has_deadline(false), cancelled(nullptr), aborted(false), structural_index(nullptr), push_input(nullptr), padded(false) {}
+	// parses only the given range of s, locations are still relative to the beginning of s
+	Context(const StringView& s, const SourceLocation& location): Context(s) {
+		position = s.begin() + location.begin;
+		end = s.begin() + location.end;
+	}
 	Context(const char* s): Context(StringView(s)) {}
 	Context(const std::vector<char>& v): Context(StringView(v.data(), v.size())) {}
-	Context(const MemoryMappedFile& f): Context(StringView(f.data(), f.size())) {}
+	Context(const MemoryMappedFile& f): Context(StringView(f.data(), f.size())) {
+		padded = f.is_padded();
+	}
+	Context(const PaddedBuffer& b): Context(StringView(b.data(), b.size())) {
+		padded = true;
+	}
+	// parses the segments in order without concatenating them; copies are only made by get_string() for strings that span several segments
+	Context(SegmentedInput& input): Context(StringView()) {
+		if (input.get_segment_count() > 0) {
+			segmented_input = &input;
+			enter_segment(0);
+			position = begin;
+		}
+	}
+	// whether there is input at the position within the current segment and the input that has arrived so far
 	explicit constexpr operator bool() const {
 		return position < end;
 	}
+	// like operator bool, but at the end of the current segment moves on to the next one and in push mode waits for more input
+	bool has_input() {
+		return position < end || next_input();
+	}
+	// the slow path of has_input(), called at the end of the current segment; not inlined so that the checks for the end of the input stay small
+	PARSER_NOINLINE bool next_input() {
+		if (segmented_input && segment + 1 < segmented_input->get_segment_count()) {
+			enter_segment(segment + 1);
+			position = begin;
+			return true;
+		}
+		return wait_for_input();
+	}
 	constexpr char operator *() const {
 		return *position;
 	}
@@ -36,22 +293,138 @@ public:
 	StringView get_error() const {
 		return StringView(error);
 	}
+	// limits the nesting of references and Pratt operands so that deeply nested input results in an ERROR
+	void set_max_depth(std::size_t max_depth) {
+		this->max_depth = max_depth;
+	}
+	bool increase_depth() {
+		if (depth == max_depth) {
+			set_error(StringView("maximum nesting depth exceeded"));
+			return false;
+		}
+		++depth;
+		return true;
+	}
+	void decrease_depth() {
+		--depth;
+	}
+	// a step is a repetition or a reference; when a limit is exceeded the parse ends with an ERROR and is_aborted()
+	void set_max_steps(std::size_t max_steps) {
+		this->max_steps = max_steps;
+		reset_countdown();
+	}
+	void set_deadline(std::chrono::steady_clock::time_point deadline) {
+		has_deadline = true;
+		this->deadline = deadline;
+		reset_countdown();
+	}
+	void set_cancellation_flag(const std::atomic<bool>* cancelled) {
+		this->cancelled = cancelled;
+		reset_countdown();
+	}
+	bool step() {
+		return --countdown != 0 || check_limits();
+	}
+	// the limits that remain at the current position
+	ContextLimits get_limits() const {
+		ContextLimits limits;
+		if (max_depth != std::size_t(-1)) {
+			limits.max_depth = max_depth - depth;
+		}
+		if (max_steps != std::size_t(-1)) {
+			const std::size_t used = steps + (interval - countdown);
+			limits.max_steps = used < max_steps ? max_steps - used : 0;
+		}
+		limits.has_deadline = has_deadline;
+		limits.deadline = deadline;
+		limits.cancelled = cancelled;
+		limits.structural_index = structural_index;
+		return limits;
+	}
+	void set_limits(const ContextLimits& limits) {
+		max_depth = limits.max_depth;
+		max_steps = limits.max_steps;
+		has_deadline = limits.has_deadline;
+		deadline = limits.deadline;
+		cancelled = limits.cancelled;
+		structural_index = limits.structural_index;
+		reset_countdown();
+	}
+	bool is_aborted() const {
+		return aborted;
+	}
+	// an optional index of the structural characters of the source, see structural.hpp
+	void set_structural_index(const StructuralIndex* structural_index) {
+		this->structural_index = structural_index;
+	}
+	const StructuralIndex* get_structural_index() const {
+		return structural_index;
+	}
+	// in push mode the end of the available input is not the end of the input
+	void set_push_input(PushInput* push_input) {
+		this->push_input = push_input;
+	}
+	// extends the available input in push mode, returns false at the end of the input
+	bool wait_for_input() {
+		if (push_input == nullptr) {
+			return false;
+		}
+		const char* new_end = push_input->wait_for_input();
+		if (new_end == nullptr) {
+			push_input = nullptr;
+			return false;
+		}
+		end = new_end;
+		return true;
+	}
 	constexpr SavePoint save() const {
 		return position;
 	}
+	bool is_segmented() const {
+		return segmented_input != nullptr;
+	}
+	// whether INPUT_PADDING zero bytes can be read after the end, which lets until() and regular() stop at the zero instead of checking for the end
+	bool is_padded() const {
+		return padded;
+	}
+	// whether the save point is within the current segment (including its end), always true if the input is not segmented
+	bool is_in_segment(SavePoint save_point) const {
+		return reinterpret_cast<std::uintptr_t>(save_point) - reinterpret_cast<std::uintptr_t>(begin) <= reinterpret_cast<std::uintptr_t>(end) - reinterpret_cast<std::uintptr_t>(begin);
+	}
 	void restore(SavePoint save_point) {
+		if (!is_in_segment(save_point)) {
+			find_segment(save_point);
+		}
 		position = save_point;
 	}
-	constexpr StringView get_string(SavePoint save_point) const {
+	StringView get_string(SavePoint save_point) const {
+		if (segmented_input && !is_in_segment(save_point)) {
+			return segmented_input->copy(save_point, position);
+		}
 		return StringView(save_point, position - save_point);
 	}
-	constexpr SourceLocation get_location() const {
-		return SourceLocation(position - begin);
+	std::size_t get_offset(SavePoint save_point) const {
+		if (segmented_input && !is_in_segment(save_point)) {
+			return segmented_input->get_offset(save_point);
+		}
+		return begin_offset + (save_point - begin);
+	}
+	SourceLocation get_location() const {
+		return SourceLocation(get_offset(position));
 	}
-	constexpr SourceLocation get_location(SavePoint save_point) const {
-		return SourceLocation(save_point - begin, position - begin);
+	SourceLocation get_location(SavePoint save_point) const {
+		return SourceLocation(get_offset(save_point), get_offset(position));
 	}
-	constexpr StringView get_source() const {
+	// the rest of the current segment if the input is segmented
+	constexpr StringView get_rest() const {
+		return StringView(position, end - position);
+	}
+	// the source that the offsets of get_location() refer to, for example to print an error
+	// segmented input is copied to a contiguous buffer on the first call, see SegmentedInput::get_source()
+	StringView get_source() const {
+		if (segmented_input) {
+			return segmented_input->get_source();
+		}
 		return StringView(begin, end - begin);
 	}
 };
@@ -59,7 +432,11 @@ public:
 enum Result: char {
 	SUCCESS,
 	FAILURE,
-	ERROR
+	ERROR,
+	// a limit of the context was exceeded; only returned by parse(), parse_impl returns ERROR
+	ABORTED,
+	// the input ended before the parse did; only returned by PushParser while it waits for more input
+	INCOMPLETE
 };
 
 template <class F> class CharClass {
@@ -98,6 +475,15 @@ public:
 	}
 };
 
+class OneOf {
+public:
+	StringView chars;
+	constexpr OneOf(const StringView& chars): chars(chars) {}
+	constexpr bool operator ()(char c) const {
+		return chars.contains(c);
+	}
+};
+
 template <class... P> class Sequence;
 template <> class Sequence<> {
 public:
@@ -134,6 +520,12 @@ public:
 	constexpr Not(P p): p(p) {}
 };
 
+template <class P> class Until {
+public:
+	P p;
+	constexpr Until(P p): p(p) {}
+};
+
 template <class P> class Ignore_ {
 public:
 	P p;
@@ -326,6 +718,9 @@ public:
 template <class F> constexpr CharClass<F> char_class(F f) {
 	return CharClass<F>(f);
 }
+constexpr CharClass<OneOf> one_of(const StringView& chars) {
+	return CharClass<OneOf>(OneOf(chars));
+}
 
 constexpr CharClass<AnyChar> any_char() {
 	return CharClass<AnyChar>(AnyChar());
@@ -363,6 +758,13 @@ template <class P> constexpr auto and_(P p) {
 constexpr auto end() {
 	return not_(any_char());
 }
+// skips characters up to the next match of p or the end of the input, equivalent to zero_or_more(sequence(not_(p), any_char()))
+template <class P> constexpr Until<P> until(P p) {
+	return Until<P>(p);
+}
+constexpr Until<StringView> until(const char* s) {
+	return Until<StringView>(StringView(s));
+}
 template <class P> constexpr Ignore_<P> ignore(P p) {
 	return Ignore_<P>(p);
 }
@@ -389,7 +791,7 @@ constexpr Expect expect(const StringView& s) {
 }
 
 template <class F, class C> Result parse_impl(const CharClass<F>& p, Context& context, const C& callback) {
-	if (context && p.f(*context)) {
+	if (context.has_input() && p.f(*context)) {
 		callback.push(*context);
 		++context;
 		return SUCCESS;
@@ -408,13 +810,14 @@ template <class C> Result parse_impl(bool (*f)(char), Context& context, const C&
 template <class C> Result parse_impl(const StringView& s, Context& context, const C& callback) {
 	const SavePoint save_point = context.save();
 	for (char c: s) {
-		if (!(context && *context == c)) {
+		if (!(context.has_input() && *context == c)) {
 			context.restore(save_point);
 			return FAILURE;
 		}
 		++context;
 	}
-	callback.push(context.get_string(save_point));
+	// a match that spans several segments is the string itself and needs no copy
+	callback.push(context.is_in_segment(save_point) ? context.get_string(save_point) : s);
 	return SUCCESS;
 }
 
@@ -454,8 +857,27 @@ template <class P0, class... P, class C> Result parse_impl(const Choice<P0, P...
 	return SUCCESS;
 }
 
+// parsers that only match characters; repeating them is linear, so they do not need to check the limits of the context
+template <class P> struct is_terminal: std::false_type {};
+template <class F> struct is_terminal<CharClass<F>>: std::true_type {};
+template <> struct is_terminal<char>: std::true_type {};
+template <> struct is_terminal<bool (*)(char)>: std::true_type {};
+template <> struct is_terminal<StringView>: std::true_type {};
+template <> struct is_terminal<const char*>: std::true_type {};
+template <> struct is_terminal<Sequence<>>: std::true_type {};
+template <class P0, class... P> struct is_terminal<Sequence<P0, P...>>: std::integral_constant<bool, is_terminal<P0>::value && is_terminal<Sequence<P...>>::value> {};
+template <> struct is_terminal<Choice<>>: std::true_type {};
+template <class P0, class... P> struct is_terminal<Choice<P0, P...>>: std::integral_constant<bool, is_terminal<P0>::value && is_terminal<Choice<P...>>::value> {};
+template <class P> struct is_terminal<Not<P>>: is_terminal<P> {};
+template <class P> struct is_terminal<Until<P>>: is_terminal<P> {};
+template <class P> struct is_terminal<Ignore_<P>>: is_terminal<P> {};
+template <class P> struct is_terminal<CollectString<P>>: is_terminal<P> {};
+
 template <class P, class C> Result parse_impl(const Repetition<P>& p, Context& context, const C& callback) {
 	while (true) {
+		if (!is_terminal<P>::value && !context.step()) {
+			return ERROR;
+		}
 		const Result result = parse_impl(p.p, context, callback);
 		if (result == ERROR) {
 			return ERROR;
@@ -480,6 +902,105 @@ template <class P, class C> Result parse_impl(const Not<P>& p, Context& context,
 	return FAILURE;
 }
 
+template <class P, class C> Result parse_impl(const Until<P>& p, Context& context, const C& callback) {
+	while (context.has_input()) {
+		const SavePoint save_point = context.save();
+		const Result result = parse_impl(p.p, context, Ignore());
+		if (result == ERROR) {
+			return ERROR;
+		}
+		if (result == SUCCESS) {
+			context.restore(save_point);
+			break;
+		}
+		++context;
+	}
+	return SUCCESS;
+}
+template <class C> Result parse_impl(const Until<char>& p, Context& context, const C& callback) {
+	while (true) {
+		const StringView rest = context.get_rest();
+		const void* position = std::memchr(rest.data(), p.p, rest.size());
+		context.restore(position ? static_cast<const char*>(position) : rest.end());
+		if (position || !context.next_input()) {
+			return SUCCESS;
+		}
+	}
+}
+template <class C> Result parse_impl(const Until<StringView>& p, Context& context, const C& callback) {
+	while (true) {
+		const StringView rest = context.get_rest();
+		const SavePoint match = find_string(rest.begin(), rest.end(), p.p);
+		if (match != rest.end()) {
+			context.restore(match);
+			return SUCCESS;
+		}
+		// a match can begin within the last characters and continue in the next segment or in input that has not arrived yet
+		context.restore(p.p.empty() || rest.size() < p.p.size() ? rest.begin() : rest.end() - (p.p.size() - 1));
+		while (context.save() != rest.end()) {
+			const SavePoint candidate = context.save();
+			if (parse_impl(p.p, context, Ignore()) == SUCCESS) {
+				context.restore(candidate);
+				return SUCCESS;
+			}
+			++context;
+		}
+		// the candidates can already have extended the input
+		if (!context.has_input()) {
+			return SUCCESS;
+		}
+	}
+}
+template <class C> Result parse_impl(const Until<const char*>& p, Context& context, const C& callback) {
+	return parse_impl(Until<StringView>(p.p), context, callback);
+}
+template <class F, class C> Result parse_impl(const Until<CharClass<F>>& p, Context& context, const C& callback) {
+	if (context.is_padded()) {
+		while (true) {
+			while (*context != '\0' && !p.p.f(*context)) {
+				++context;
+			}
+			if (!context.has_input() || p.p.f(*context)) {
+				return SUCCESS;
+			}
+			++context;
+		}
+	}
+	while (context.has_input() && !p.p.f(*context)) {
+		++context;
+	}
+	return SUCCESS;
+}
+template <class C> Result parse_impl(const Until<CharClass<OneOf>>& p, Context& context, const C& callback) {
+	CharFinder finder;
+	for (char c: p.p.f.chars) {
+		if (!finder.insert(c)) {
+			// too many characters for CharFinder
+			while (context.has_input() && !p.p.f(*context)) {
+				++context;
+			}
+			return SUCCESS;
+		}
+	}
+	if (context.is_padded()) {
+		const StringView rest = context.get_rest();
+		context.restore(finder.find_padded(rest.begin(), rest.end()));
+		return SUCCESS;
+	}
+	while (true) {
+		const StringView rest = context.get_rest();
+		const SavePoint position = finder.find(rest.begin(), rest.end());
+		context.restore(position);
+		if (position != rest.end() || !context.next_input()) {
+			return SUCCESS;
+		}
+	}
+}
+// the idiom zero_or_more(sequence(not_(p), any_char())) skips characters like until(p) if they are ignored
+template <class P> Result parse_impl(const Repetition<Sequence<Not<P>, CharClass<AnyChar>>>& p, Context& context, const Ignore& callback) {
+	return parse_impl(Until<P>(p.p.head.p), context, callback);
+}
+
 template <class P, class C> Result parse_impl(const Ignore_<P>& p, Context& context, const C& callback) {
 	return parse_impl(p.p, context, Ignore());
 }
@@ -538,25 +1059,42 @@ template <class C> Result parse_impl(const Expect& p, Context& context, const C&
 		return ERROR;
 	}
 	if (result == FAILURE) {
-		context.set_error(printer::format("expected \"%\"", p.s));
+		context.set_error(printer::format(FORMAT_STRING("expected \"%\""), p.s));
 		return ERROR;
 	}
 	return SUCCESS;
 }
 
 template <class T, class C> Result parse_impl(const Reference_<T>& p, Context& context, const C& callback) {
-	return parse_impl(T::parser, context, callback);
+	if (!context.step() || !context.increase_depth()) {
+		return ERROR;
+	}
+	const Result result = parse_impl(T::parser, context, callback);
+	context.decrease_depth();
+	return result;
 }
 
 }
 
 template <class P, class C> parser::Result parse(parser::Context& context, P&& p, const C& callback) {
 	using namespace parser;
-	return parse_impl(std::forward<P>(p), context, callback);
+	const Result result = parse_impl(std::forward<P>(p), context, callback);
+	return result == ERROR && context.is_aborted() ? ABORTED : result;
 }
 template <class P> parser::Result parse(parser::Context& context, P&& p) {
 	return parse(context, std::forward<P>(p), parser::Ignore());
 }
+// parse on a separately allocated stack so that the nesting depth is limited by its size instead of the thread's stack
+template <class P, class C> parser::Result parse(Stack& stack, parser::Context& context, P&& p, const C& callback) {
+	parser::Result result = parser::FAILURE;
+	stack.run([&]() {
+		result = parse(context, std::forward<P>(p), callback);
+	});
+	return result;
+}
+template <class P> parser::Result parse(Stack& stack, parser::Context& context, P&& p) {
+	return parse(stack, context, std::forward<P>(p), parser::Ignore());
+}
 template <class P> parser::Result parse(const StringView& s, P&& p) {
 	parser::Context context(s);
 	return parse(context, std::forward<P>(p));
@@ -0,0 +1,897 @@
+#pragma once
+
+#include "parser.hpp"
+#include "analysis.hpp"
+#include <map>
+#include <unordered_map>
+
+namespace parser {
+
+// a grammar in PEG notation that is parsed and compiled at runtime:
+//   Name <- Expression
+// with the operators / (ordered choice), & and ! (predicates), ?, * and +, 'literal' or "literal", [a-z] and [^a-z], . and parentheses
+// # starts a comment; the first rule is the start rule and the matches of rules whose names start with _ are not captured
+
+class PegExpression {
+public:
+	enum Type {
+		CHOICE,
+		SEQUENCE,
+		NOT,
+		AND,
+		OPTIONAL,
+		ZERO_OR_MORE,
+		ONE_OR_MORE,
+		REFERENCE,
+		LITERAL,
+		CLASS,
+		ANY
+	};
+	Type type;
+	std::vector<PegExpression> children;
+	// the characters of a literal or the name of a reference
+	std::string string;
+	CharSet chars;
+	SourceLocation location;
+	PegExpression(Type type): type(type) {}
+};
+
+class PegRule {
+public:
+	std::string name;
+	PegExpression expression;
+	SourceLocation location;
+	PegRule(): expression(PegExpression::SEQUENCE) {}
+};
+
+class PegRange {
+public:
+	char first;
+	char last;
+	PegRange(char first, char last): first(first), last(last) {}
+};
+
+class PegNegate {
+public:
+	constexpr PegNegate() {}
+};
+
+template <PegExpression::Type type> class PegCollector {
+	PegExpression expression;
+	bool negate;
+public:
+	PegCollector(): expression(type), negate(false) {}
+	void push(PegExpression&& child) {
+		expression.children.push_back(std::move(child));
+	}
+	void push(char c) {
+		expression.string.push_back(c);
+	}
+	void push(const StringView& name) {
+		expression.string = name.to_string();
+	}
+	void push(const PegRange& range) {
+		expression.chars = expression.chars | CharSet(range.first, range.last);
+	}
+	void push(PegNegate) {
+		negate = true;
+	}
+	void set_location(const SourceLocation& location) {
+		expression.location = location;
+	}
+	template <class C> void retrieve(const C& callback) {
+		if ((type == PegExpression::CHOICE || type == PegExpression::SEQUENCE) && expression.children.size() == 1) {
+			callback.push(std::move(expression.children[0]));
+			return;
+		}
+		if (negate) {
+			CharSet chars;
+			for (unsigned int i = 0; i < 256; ++i) {
+				if (!expression.chars.contains(static_cast<char>(i))) {
+					chars.insert(static_cast<char>(i));
+				}
+			}
+			expression.chars = chars;
+		}
+		callback.push(std::move(expression));
+	}
+};
+
+// a primary expression with an optional prefix or suffix operator
+class PegUnaryCollector {
+	PegExpression expression;
+	bool has_operator;
+	PegExpression::Type type;
+public:
+	PegUnaryCollector(): expression(PegExpression::SEQUENCE), has_operator(false), type(PegExpression::SEQUENCE) {}
+	void push(PegExpression&& expression) {
+		this->expression = std::move(expression);
+	}
+	void push(PegExpression::Type type) {
+		has_operator = true;
+		this->type = type;
+	}
+	template <class C> void retrieve(const C& callback) {
+		if (has_operator) {
+			PegExpression result(type);
+			result.children.push_back(std::move(expression));
+			callback.push(std::move(result));
+		}
+		else {
+			callback.push(std::move(expression));
+		}
+	}
+};
+
+class PegRangeCollector {
+	char chars[2];
+	unsigned int count;
+public:
+	PegRangeCollector(): count(0) {}
+	void push(char c) {
+		chars[count] = c;
+		++count;
+	}
+	template <class C> void retrieve(const C& callback) {
+		callback.push(PegRange(chars[0], chars[count - 1]));
+	}
+};
+
+class PegEscapeCollector {
+	char c;
+public:
+	PegEscapeCollector(): c('\0') {}
+	void push(char c) {
+		this->c = c == 'n' ? '\n' : c == 'r' ? '\r' : c == 't' ? '\t' : c;
+	}
+	template <class C> void retrieve(const C& callback) {
+		callback.push(c);
+	}
+};
+
+class PegRuleCollector {
+	PegRule rule;
+public:
+	void push(const StringView& name) {
+		rule.name = name.to_string();
+	}
+	void push(PegExpression&& expression) {
+		rule.expression = std::move(expression);
+	}
+	void set_location(const SourceLocation& location) {
+		rule.location = location;
+	}
+	template <class C> void retrieve(const C& callback) {
+		callback.push(std::move(rule));
+	}
+};
+
+template <PegExpression::Type type> using PegOperator = ConstantCollector<PegExpression::Type, type>;
+
+// the grammar of the grammars, a class template so that it can be defined in a header
+template <class T> struct peg_expression_t;
+constexpr Reference_<peg_expression_t<void>> peg_expression;
+
+constexpr auto peg_spacing = ignore(zero_or_more(choice(one_of(" \t\r\n"), sequence('#', until('\n')))));
+constexpr auto peg_identifier = sequence(
+	collect_string(sequence(choice(range('a', 'z'), range('A', 'Z'), '_'), zero_or_more(choice(range('a', 'z'), range('A', 'Z'), range('0', '9'), '_')))),
+	peg_spacing
+);
+constexpr auto peg_arrow = sequence(ignore("<-"), peg_spacing);
+constexpr auto peg_char = choice(
+	collect<PegEscapeCollector>(sequence(ignore('\\'), choice(any_char(), error("unterminated escape sequence")))),
+	any_char()
+);
+constexpr auto peg_literal = choice(
+	sequence(ignore('\''), zero_or_more(sequence(not_(one_of("'\n")), peg_char)), expect("'"), peg_spacing),
+	sequence(ignore('"'), zero_or_more(sequence(not_(one_of("\"\n")), peg_char)), expect("\""), peg_spacing)
+);
+constexpr auto peg_class = sequence(
+	ignore('['),
+	optional(tag<PegNegate>(ignore('^'))),
+	zero_or_more(collect<PegRangeCollector>(sequence(not_(one_of("]\n")), peg_char, optional(sequence(ignore('-'), not_(one_of("]\n")), peg_char))))),
+	expect("]"),
+	peg_spacing
+);
+constexpr auto peg_primary = choice(
+	collect<PegCollector<PegExpression::REFERENCE>>(collect_location(sequence(peg_identifier, not_(peg_arrow)))),
+	sequence(ignore('('), peg_spacing, peg_expression, expect(")"), peg_spacing),
+	collect<PegCollector<PegExpression::LITERAL>>(peg_literal),
+	collect<PegCollector<PegExpression::CLASS>>(peg_class),
+	collect<PegCollector<PegExpression::ANY>>(sequence(ignore('.'), peg_spacing))
+);
+constexpr auto peg_suffix = sequence(
+	peg_primary,
+	optional(sequence(choice(
+		collect<PegOperator<PegExpression::OPTIONAL>>(ignore('?')),
+		collect<PegOperator<PegExpression::ZERO_OR_MORE>>(ignore('*')),
+		collect<PegOperator<PegExpression::ONE_OR_MORE>>(ignore('+'))
+	), peg_spacing))
+);
+constexpr auto peg_prefix = collect<PegUnaryCollector>(choice(
+	sequence(choice(
+		collect<PegOperator<PegExpression::AND>>(ignore('&')),
+		collect<PegOperator<PegExpression::NOT>>(ignore('!'))
+	), peg_spacing, collect<PegUnaryCollector>(peg_suffix)),
+	peg_suffix
+));
+constexpr auto peg_sequence = collect<PegCollector<PegExpression::SEQUENCE>>(zero_or_more(peg_prefix));
+template <class T> struct peg_expression_t {
+	static constexpr auto parser = collect<PegCollector<PegExpression::CHOICE>>(sequence(
+		peg_sequence,
+		zero_or_more(sequence(ignore('/'), peg_spacing, peg_sequence))
+	));
+};
+template <class T> constexpr decltype(peg_expression_t<T>::parser) peg_expression_t<T>::parser;
+constexpr auto peg_definition = collect<PegRuleCollector>(sequence(collect_location(peg_identifier), expect("<-"), peg_spacing, peg_expression));
+constexpr auto peg_grammar = sequence(
+	peg_spacing,
+	collect<VectorCollector<PegRule>>(one_or_more(peg_definition)),
+	choice(end(), error("expected a definition"))
+);
+
+// each instruction is a 32-bit word with the opcode in the low 8 bits and the operand in the high 24 bits
+enum class PegOpcode: std::uint8_t {
+	// matches the character in the operand
+	CHAR,
+	ANY,
+	// matches a character of sets[operand]
+	SET,
+	// matches strings[operand]
+	STRING,
+	// skips the characters of sets[operand]
+	SPAN,
+	// pushes a backtrack entry that continues at the operand
+	CHOICE,
+	// pops the backtrack entry and jumps
+	COMMIT,
+	// updates the backtrack entry to the current position and jumps back, ends the loop if no input was consumed
+	PARTIAL_COMMIT,
+	// pops the backtrack entry, restores its position and jumps
+	BACK_COMMIT,
+	FAIL,
+	// pops the backtrack entry and fails
+	FAIL_TWICE,
+	// calls the rule in the operand
+	CALL,
+	RETURN,
+	// starts and ends the capture of the rule in the operand
+	OPEN,
+	CLOSE,
+	END
+};
+
+class PegProgram {
+public:
+	std::vector<std::uint32_t> code;
+	std::vector<CharSet> sets;
+	std::vector<std::string> strings;
+	std::vector<std::string> rule_names;
+	std::vector<std::uint32_t> rule_addresses;
+	static constexpr std::uint32_t MAX_OPERAND = 0xFFFFFF;
+	static constexpr PegOpcode get_opcode(std::uint32_t instruction) {
+		return static_cast<PegOpcode>(instruction & 0xFF);
+	}
+	static constexpr std::uint32_t get_operand(std::uint32_t instruction) {
+		return instruction >> 8;
+	}
+	StringView get_rule_name(std::uint32_t rule) const {
+		return StringView(rule_names[rule]);
+	}
+};
+
+class PegCompiler {
+	PegProgram& program;
+	std::map<std::string, std::uint32_t> rules;
+	Context& context;
+	std::uint32_t emit(PegOpcode opcode, std::uint32_t operand = 0) {
+		program.code.push_back(static_cast<std::uint32_t>(opcode) | operand << 8);
+		return program.code.size() - 1;
+	}
+	// sets the target of the jump at instruction to the next instruction
+	void patch(std::uint32_t instruction) {
+		program.code[instruction] = (program.code[instruction] & 0xFF) | static_cast<std::uint32_t>(program.code.size()) << 8;
+	}
+	std::uint32_t add_set(const CharSet& chars) {
+		program.sets.push_back(chars);
+		return program.sets.size() - 1;
+	}
+	bool compile(const PegExpression& expression) {
+		if (program.code.size() >= PegProgram::MAX_OPERAND || program.sets.size() >= PegProgram::MAX_OPERAND || program.strings.size() >= PegProgram::MAX_OPERAND) {
+			context.set_error(StringView("grammar too large"));
+			return false;
+		}
+		switch (expression.type) {
+		case PegExpression::CHOICE: {
+			std::vector<std::uint32_t> commits;
+			for (std::size_t i = 0; i + 1 < expression.children.size(); ++i) {
+				const std::uint32_t choice = emit(PegOpcode::CHOICE);
+				if (!compile(expression.children[i])) {
+					return false;
+				}
+				commits.push_back(emit(PegOpcode::COMMIT));
+				patch(choice);
+			}
+			if (!compile(expression.children.back())) {
+				return false;
+			}
+			for (std::uint32_t commit: commits) {
+				patch(commit);
+			}
+			return true;
+		}
+		case PegExpression::SEQUENCE:
+			for (const PegExpression& child: expression.children) {
+				if (!compile(child)) {
+					return false;
+				}
+			}
+			return true;
+		case PegExpression::NOT: {
+			const std::uint32_t choice = emit(PegOpcode::CHOICE);
+			if (!compile(expression.children[0])) {
+				return false;
+			}
+			emit(PegOpcode::FAIL_TWICE);
+			patch(choice);
+			return true;
+		}
+		case PegExpression::AND: {
+			const std::uint32_t choice = emit(PegOpcode::CHOICE);
+			if (!compile(expression.children[0])) {
+				return false;
+			}
+			const std::uint32_t commit = emit(PegOpcode::BACK_COMMIT);
+			patch(choice);
+			emit(PegOpcode::FAIL);
+			patch(commit);
+			return true;
+		}
+		case PegExpression::OPTIONAL: {
+			const std::uint32_t choice = emit(PegOpcode::CHOICE);
+			if (!compile(expression.children[0])) {
+				return false;
+			}
+			patch(emit(PegOpcode::COMMIT));
+			patch(choice);
+			return true;
+		}
+		case PegExpression::ONE_OR_MORE:
+			if (!compile(expression.children[0])) {
+				return false;
+			}
+			// fall through
+		case PegExpression::ZERO_OR_MORE: {
+			const PegExpression& child = expression.children[0];
+			if (child.type == PegExpression::CLASS) {
+				emit(PegOpcode::SPAN, add_set(child.chars));
+				return true;
+			}
+			if (child.type == PegExpression::LITERAL && child.string.size() == 1) {
+				emit(PegOpcode::SPAN, add_set(CharSet(child.string[0])));
+				return true;
+			}
+			const std::uint32_t choice = emit(PegOpcode::CHOICE);
+			const std::uint32_t body = program.code.size();
+			if (!compile(child)) {
+				return false;
+			}
+			emit(PegOpcode::PARTIAL_COMMIT, body);
+			patch(choice);
+			return true;
+		}
+		case PegExpression::REFERENCE: {
+			auto rule = rules.find(expression.string);
+			if (rule == rules.end()) {
+				context.restore(context.get_source().begin() + expression.location.begin);
+				context.set_error(printer::format(FORMAT_STRING("undefined rule \"%\""), StringView(expression.string)));
+				return false;
+			}
+			emit(PegOpcode::CALL, rule->second);
+			return true;
+		}
+		case PegExpression::LITERAL:
+			if (expression.string.size() == 1) {
+				emit(PegOpcode::CHAR, static_cast<unsigned char>(expression.string[0]));
+			}
+			else if (expression.string.size() > 1) {
+				program.strings.push_back(expression.string);
+				emit(PegOpcode::STRING, program.strings.size() - 1);
+			}
+			return true;
+		case PegExpression::CLASS:
+			emit(PegOpcode::SET, add_set(expression.chars));
+			return true;
+		case PegExpression::ANY:
+			emit(PegOpcode::ANY);
+			return true;
+		}
+		return false;
+	}
+	// the rules that can succeed without consuming input
+	std::vector<bool> nullable;
+	bool is_nullable(const PegExpression& expression) const {
+		switch (expression.type) {
+		case PegExpression::CHOICE:
+			for (const PegExpression& child: expression.children) {
+				if (is_nullable(child)) {
+					return true;
+				}
+			}
+			return false;
+		case PegExpression::SEQUENCE:
+			for (const PegExpression& child: expression.children) {
+				if (!is_nullable(child)) {
+					return false;
+				}
+			}
+			return true;
+		case PegExpression::NOT:
+		case PegExpression::AND:
+		case PegExpression::OPTIONAL:
+		case PegExpression::ZERO_OR_MORE:
+			return true;
+		case PegExpression::ONE_OR_MORE:
+			return is_nullable(expression.children[0]);
+		case PegExpression::REFERENCE: {
+			auto rule = rules.find(expression.string);
+			return rule != rules.end() && nullable[rule->second];
+		}
+		case PegExpression::LITERAL:
+			return expression.string.empty();
+		case PegExpression::CLASS:
+		case PegExpression::ANY:
+			return false;
+		}
+		return false;
+	}
+	// adds the rules that the expression can call before it has consumed any input
+	void get_left_calls(const PegExpression& expression, std::vector<std::uint32_t>& calls) const {
+		switch (expression.type) {
+		case PegExpression::CHOICE:
+			for (const PegExpression& child: expression.children) {
+				get_left_calls(child, calls);
+			}
+			break;
+		case PegExpression::SEQUENCE:
+			for (const PegExpression& child: expression.children) {
+				get_left_calls(child, calls);
+				if (!is_nullable(child)) {
+					break;
+				}
+			}
+			break;
+		case PegExpression::NOT:
+		case PegExpression::AND:
+		case PegExpression::OPTIONAL:
+		case PegExpression::ZERO_OR_MORE:
+		case PegExpression::ONE_OR_MORE:
+			get_left_calls(expression.children[0], calls);
+			break;
+		case PegExpression::REFERENCE: {
+			auto rule = rules.find(expression.string);
+			if (rule != rules.end()) {
+				calls.push_back(rule->second);
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	// a rule that can call itself without consuming input recurses until the depth limit is exceeded or the memory is exhausted
+	bool check_left_recursion(const std::vector<PegRule>& grammar) {
+		nullable.assign(grammar.size(), false);
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (std::size_t i = 0; i < grammar.size(); ++i) {
+				if (!nullable[i] && is_nullable(grammar[i].expression)) {
+					nullable[i] = true;
+					changed = true;
+				}
+			}
+		}
+		std::vector<std::vector<std::uint32_t>> calls(grammar.size());
+		for (std::size_t i = 0; i < grammar.size(); ++i) {
+			get_left_calls(grammar[i].expression, calls[i]);
+		}
+		// a depth-first search for a cycle of calls, with an explicit stack since a grammar can have many rules
+		enum: char {
+			UNVISITED,
+			ACTIVE,
+			DONE
+		};
+		std::vector<char> states(grammar.size(), UNVISITED);
+		std::vector<std::pair<std::uint32_t, std::size_t>> stack;
+		for (std::uint32_t root = 0; root < grammar.size(); ++root) {
+			if (states[root] != UNVISITED) {
+				continue;
+			}
+			states[root] = ACTIVE;
+			stack.emplace_back(root, 0);
+			while (!stack.empty()) {
+				const std::uint32_t rule = stack.back().first;
+				if (stack.back().second == calls[rule].size()) {
+					states[rule] = DONE;
+					stack.pop_back();
+					continue;
+				}
+				const std::uint32_t callee = calls[rule][stack.back().second];
+				++stack.back().second;
+				if (states[callee] == ACTIVE) {
+					context.restore(context.get_source().begin() + grammar[callee].location.begin);
+					context.set_error(printer::format(FORMAT_STRING("left recursive rule \"%\""), StringView(grammar[callee].name)));
+					return false;
+				}
+				if (states[callee] == UNVISITED) {
+					states[callee] = ACTIVE;
+					stack.emplace_back(callee, 0);
+				}
+			}
+		}
+		return true;
+	}
+public:
+	PegCompiler(PegProgram& program, Context& context): program(program), context(context) {}
+	bool compile(const std::vector<PegRule>& grammar) {
+		for (const PegRule& rule: grammar) {
+			if (!rules.emplace(rule.name, program.rule_names.size()).second) {
+				context.restore(context.get_source().begin() + rule.location.begin);
+				context.set_error(printer::format(FORMAT_STRING("duplicate rule \"%\""), StringView(rule.name)));
+				return false;
+			}
+			program.rule_names.push_back(rule.name);
+		}
+		// the entry point calls the start rule
+		emit(PegOpcode::CALL, 0);
+		emit(PegOpcode::END);
+		for (std::uint32_t i = 0; i < grammar.size(); ++i) {
+			const bool captured = grammar[i].name[0] != '_';
+			program.rule_addresses.push_back(program.code.size());
+			if (captured) {
+				emit(PegOpcode::OPEN, i);
+			}
+			if (!compile(grammar[i].expression)) {
+				return false;
+			}
+			if (captured) {
+				emit(PegOpcode::CLOSE, i);
+			}
+			emit(PegOpcode::RETURN);
+		}
+		return check_left_recursion(grammar);
+	}
+};
+
+// parses the grammar in the context and compiles it; returns ERROR with a message for invalid grammars
+inline Result compile_peg(Context& context, PegProgram& program) {
+	std::vector<PegRule> grammar;
+	const Result result = parse_impl(peg_grammar, context, GetValueCallback<std::vector<PegRule>>(grammar));
+	if (result == FAILURE) {
+		context.set_error(StringView("expected a definition"));
+		return ERROR;
+	}
+	if (result == ERROR) {
+		return ERROR;
+	}
+	program = PegProgram();
+	PegCompiler compiler(program, context);
+	return compiler.compile(grammar) ? SUCCESS : ERROR;
+}
+
+// an event of the capture log, rule is CLOSE for the end of the last open capture
+class PegEvent {
+public:
+	static constexpr std::uint32_t CLOSE = -1;
+	std::uint32_t rule;
+	std::size_t offset;
+	PegEvent(std::uint32_t rule, std::size_t offset): rule(rule), offset(offset) {}
+};
+
+// a match of a captured rule; the captures are in preorder and size includes the capture itself and its descendants
+class PegCapture {
+public:
+	std::uint32_t rule;
+	SourceLocation location;
+	std::size_t size;
+	PegCapture(std::uint32_t rule, const SourceLocation& location): rule(rule), location(location), size(1) {}
+};
+
+class PegTree {
+public:
+	std::vector<PegCapture> captures;
+};
+
+class PegMemoEntry {
+public:
+	bool success;
+	std::size_t end;
+	std::vector<PegEvent> events;
+	PegMemoEntry(): success(false), end(0) {}
+};
+
+// a hook to memoize the results of rule calls by offset; returning nullptr from lookup() disables memoization
+class PegMemo {
+public:
+	virtual ~PegMemo() {}
+	virtual const PegMemoEntry* lookup(std::uint32_t rule, std::size_t offset) = 0;
+	virtual void store(std::uint32_t rule, std::size_t offset, PegMemoEntry&& entry) = 0;
+};
+
+// packrat parsing, every rule call is memoized
+class PegPackratMemo: public PegMemo {
+	std::unordered_map<std::uint64_t, PegMemoEntry> entries;
+	static std::uint64_t key(std::uint32_t rule, std::size_t offset) {
+		return static_cast<std::uint64_t>(offset) << 24 | rule;
+	}
+public:
+	const PegMemoEntry* lookup(std::uint32_t rule, std::size_t offset) override {
+		auto entry = entries.find(key(rule, offset));
+		return entry != entries.end() ? &entry->second : nullptr;
+	}
+	void store(std::uint32_t rule, std::size_t offset, PegMemoEntry&& entry) override {
+		entries[key(rule, offset)] = std::move(entry);
+	}
+	void clear() {
+		entries.clear();
+	}
+};
+
+class PegFrame {
+public:
+	// the address to continue at after a return or a failure
+	const std::uint32_t* address;
+	SavePoint position;
+	std::size_t events;
+	// the called rule or NO_RULE for a backtrack entry
+	std::uint32_t rule;
+	static constexpr std::uint32_t NO_RULE = -1;
+	PegFrame(const std::uint32_t* address, SavePoint position, std::size_t events, std::uint32_t rule): address(address), position(position), events(events), rule(rule) {}
+};
+
+// the virtual machine, with threaded dispatch where computed gotos are available
+inline Result run_peg(const PegProgram& program, PegMemo* memo, Context& context, PegTree& tree) {
+	const std::uint32_t* const code = program.code.data();
+	const std::uint32_t* ip = code;
+	const SavePoint begin = context.get_source().begin();
+	const SavePoint start = context.save();
+	SavePoint end = context.get_rest().end();
+	// in push mode more input can arrive at the end
+	auto wait_for_input = [&]() {
+		if (!context.wait_for_input()) {
+			return false;
+		}
+		end = context.get_rest().end();
+		return true;
+	};
+	SavePoint position = start;
+	std::vector<PegFrame> stack;
+	std::vector<PegEvent> events;
+	std::uint32_t operand = 0;
+#if defined(__GNUC__)
+	static void* const labels[] = {
+		&&CHAR, &&ANY, &&SET, &&STRING, &&SPAN, &&CHOICE, &&COMMIT, &&PARTIAL_COMMIT, &&BACK_COMMIT,
+		&&FAIL, &&FAIL_TWICE, &&CALL, &&RETURN, &&OPEN, &&CLOSE, &&END
+	};
+#define PEG_NEXT() operand = PegProgram::get_operand(*ip); goto *labels[*ip & 0xFF]
+#define PEG_CASE(opcode) opcode:
+	PEG_NEXT();
+	{
+#else
+#define PEG_NEXT() continue
+#define PEG_CASE(opcode) case PegOpcode::opcode:
+	while (true) {
+		operand = PegProgram::get_operand(*ip);
+		switch (PegProgram::get_opcode(*ip)) {
+#endif
+	PEG_CASE(CHAR)
+		if ((position < end || wait_for_input()) && *position == static_cast<char>(operand)) {
+			++position;
+			++ip;
+			PEG_NEXT();
+		}
+		goto fail;
+	PEG_CASE(ANY)
+		if (position < end || wait_for_input()) {
+			++position;
+			++ip;
+			PEG_NEXT();
+		}
+		goto fail;
+	PEG_CASE(SET)
+		if ((position < end || wait_for_input()) && program.sets[operand].contains(*position)) {
+			++position;
+			++ip;
+			PEG_NEXT();
+		}
+		goto fail;
+	PEG_CASE(STRING) {
+		const std::string& s = program.strings[operand];
+		std::size_t i = 0;
+		if (static_cast<std::size_t>(end - position) >= s.size()) {
+			i = std::memcmp(position, s.data(), s.size()) == 0 ? s.size() : 0;
+		}
+		else {
+			while (i < s.size() && (position + i < end || wait_for_input()) && position[i] == s[i]) {
+				++i;
+			}
+		}
+		if (i == s.size()) {
+			position += s.size();
+			++ip;
+			PEG_NEXT();
+		}
+		goto fail;
+	}
+	PEG_CASE(SPAN) {
+		const CharSet& set = program.sets[operand];
+		while ((position < end || wait_for_input()) && set.contains(*position)) {
+			++position;
+		}
+		++ip;
+		PEG_NEXT();
+	}
+	PEG_CASE(CHOICE)
+		stack.push_back(PegFrame(code + operand, position, events.size(), PegFrame::NO_RULE));
+		++ip;
+		PEG_NEXT();
+	PEG_CASE(COMMIT)
+		stack.pop_back();
+		ip = code + operand;
+		PEG_NEXT();
+	PEG_CASE(PARTIAL_COMMIT) {
+		PegFrame& frame = stack.back();
+		if (position == frame.position) {
+			// the body did not consume any input, repeating it would not terminate
+			ip = frame.address;
+			stack.pop_back();
+			PEG_NEXT();
+		}
+		if (!context.step()) {
+			goto error;
+		}
+		frame.position = position;
+		frame.events = events.size();
+		ip = code + operand;
+		PEG_NEXT();
+	}
+	PEG_CASE(BACK_COMMIT)
+		position = stack.back().position;
+		events.erase(events.begin() + stack.back().events, events.end());
+		stack.pop_back();
+		ip = code + operand;
+		PEG_NEXT();
+	PEG_CASE(FAIL)
+		goto fail;
+	PEG_CASE(FAIL_TWICE)
+		stack.pop_back();
+		goto fail;
+	PEG_CASE(CALL)
+		if (!context.step()) {
+			goto error;
+		}
+		if (memo) {
+			if (const PegMemoEntry* entry = memo->lookup(operand, position - begin)) {
+				if (!entry->success) {
+					goto fail;
+				}
+				events.insert(events.end(), entry->events.begin(), entry->events.end());
+				position = begin + entry->end;
+				++ip;
+				PEG_NEXT();
+			}
+		}
+		if (!context.increase_depth()) {
+			goto error;
+		}
+		stack.emplace_back(ip + 1, position, events.size(), operand);
+		ip = code + program.rule_addresses[operand];
+		PEG_NEXT();
+	PEG_CASE(RETURN) {
+		const PegFrame& frame = stack.back();
+		context.decrease_depth();
+		if (memo) {
+			PegMemoEntry entry;
+			entry.success = true;
+			entry.end = position - begin;
+			entry.events.assign(events.begin() + frame.events, events.end());
+			memo->store(frame.rule, frame.position - begin, std::move(entry));
+		}
+		ip = frame.address;
+		stack.pop_back();
+		PEG_NEXT();
+	}
+	PEG_CASE(OPEN)
+		events.emplace_back(operand, position - begin);
+		++ip;
+		PEG_NEXT();
+	PEG_CASE(CLOSE)
+		events.push_back(PegEvent(PegEvent::CLOSE, position - begin));
+		++ip;
+		PEG_NEXT();
+	PEG_CASE(END) {
+		context.restore(position);
+		tree.captures.clear();
+		tree.captures.reserve(events.size() / 2);
+		std::vector<std::size_t> open;
+		for (const PegEvent& event: events) {
+			if (event.rule == PegEvent::CLOSE) {
+				PegCapture& capture = tree.captures[open.back()];
+				capture.location.end = event.offset;
+				capture.size = tree.captures.size() - open.back();
+				open.pop_back();
+			}
+			else {
+				open.push_back(tree.captures.size());
+				tree.captures.emplace_back(event.rule, SourceLocation(event.offset, event.offset));
+			}
+		}
+		return SUCCESS;
+	}
+	fail:
+		// unwind the calls up to the last backtrack entry
+		while (!stack.empty() && stack.back().rule != PegFrame::NO_RULE) {
+			const PegFrame& frame = stack.back();
+			context.decrease_depth();
+			if (memo) {
+				PegMemoEntry entry;
+				memo->store(frame.rule, frame.position - begin, std::move(entry));
+			}
+			stack.pop_back();
+		}
+		if (stack.empty()) {
+			context.restore(start);
+			return FAILURE;
+		}
+		ip = stack.back().address;
+		position = stack.back().position;
+		events.erase(events.begin() + stack.back().events, events.end());
+		stack.pop_back();
+		PEG_NEXT();
+#if !defined(__GNUC__)
+		}
+#endif
+	}
+#undef PEG_NEXT
+#undef PEG_CASE
+	error:
+	for (const PegFrame& frame: stack) {
+		if (frame.rule != PegFrame::NO_RULE) {
+			context.decrease_depth();
+		}
+	}
+	context.restore(position);
+	return ERROR;
+}
+
+// runs a compiled grammar as a parser, pushing a PegTree of the captures; the program and the memo have to outlive the parser
+class Peg {
+public:
+	const PegProgram* program;
+	PegMemo* memo;
+	constexpr Peg(const PegProgram* program, PegMemo* memo): program(program), memo(memo) {}
+};
+
+inline Peg peg(const PegProgram& program, PegMemo* memo = nullptr) {
+	return Peg(&program, memo);
+}
+
+template <class C> Result parse_impl(const Peg& p, Context& context, const C& callback) {
+	if (context.is_segmented()) {
+		context.set_error(StringView("PEG programs require contiguous input"));
+		return ERROR;
+	}
+	PegTree tree;
+	const Result result = run_peg(*p.program, p.memo, context, tree);
+	if (result == SUCCESS) {
+		callback.push(std::move(tree));
+	}
+	return result;
+}
+
+template <class V> GrammarInfo analyze_impl(const Peg& p, V) {
+	return GrammarInfo::unknown();
+}
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "parser.hpp"
+#include "analysis.hpp"
 
 namespace parser {
 
@@ -46,18 +47,130 @@ public:
 	constexpr PrattLevel(P0 head, P... tail): head(head), tail(tail...) {}
 };
 
-template <class T, class... P> class Pratt;
-template <class T> class Pratt<T> {
+template <class P> class Trivia {
+	static constexpr CharSet get_first(const GrammarInfo& info) {
+		return info.eager_error ? CharSet::all() : info.first;
+	}
 public:
-	constexpr Pratt() {}
+	P p;
+	// the characters the trivia can start with; at any other character it is skipped without being parsed
+	CharSet first;
+	constexpr Trivia(P p): p(p), first(get_first(analyze_impl(p, OpaqueReferences()))) {}
 };
-template <class T, class P0, class... P> class Pratt<T, P0, P...> {
+
+template <class... P> class PrattLevels;
+template <> class PrattLevels<> {
+public:
+	constexpr PrattLevels() {}
+};
+template <class P0, class... P> class PrattLevels<P0, P...> {
 public:
 	P0 head;
-	Pratt<T, P...> tail;
-	constexpr Pratt(P0 head, P... tail): head(head), tail(tail...) {}
+	PrattLevels<P...> tail;
+	constexpr PrattLevels(P0 head, P... tail): head(head), tail(tail...) {}
+};
+
+// the number of operators in a PrattLevel or in all remaining PrattLevels
+template <class L> struct pratt_operator_count;
+template <class... Op> struct pratt_operator_count<PrattLevel<Op...>>: std::integral_constant<std::size_t, sizeof...(Op)> {};
+template <> struct pratt_operator_count<PrattLevels<>>: std::integral_constant<std::size_t, 0> {};
+template <class L0, class... L> struct pratt_operator_count<PrattLevels<L0, L...>>: std::integral_constant<std::size_t, pratt_operator_count<L0>::value + pratt_operator_count<PrattLevels<L...>>::value> {};
+
+// for every character (and the end of the input) the set of operators that have to be tried, one bit per operator
+// operators after the 64th are always tried
+class PrattTable {
+	std::uint64_t masks[257];
+public:
+	static constexpr std::size_t MAX_OPERATORS = 64;
+	constexpr PrattTable(): masks{} {}
+	constexpr void insert(std::size_t index, const GrammarInfo& info) {
+		if (index >= MAX_OPERATORS) {
+			return;
+		}
+		for (int c = -1; c < 256; ++c) {
+			if (info.can_start_with(c)) {
+				masks[c + 1] |= std::uint64_t(1) << index;
+			}
+		}
+	}
+	std::uint64_t get(const Context& context) const {
+		return context ? masks[static_cast<unsigned char>(*context) + 1] : masks[0];
+	}
+	static constexpr std::uint64_t get_mask(std::size_t first_index) {
+		return first_index >= MAX_OPERATORS ? 0 : ~std::uint64_t(0) << first_index;
+	}
+	static constexpr bool contains(std::uint64_t candidates, std::size_t index) {
+		return index >= MAX_OPERATORS || (candidates >> index & 1);
+	}
+};
+
+template <class Op> constexpr void insert_nud(PrattTable& table, std::size_t index, const Op& op) {}
+template <class Op_P> constexpr void insert_nud(PrattTable& table, std::size_t index, const Terminal<Op_P>& op) {
+	table.insert(index, analyze_impl(op.p, OpaqueReferences()));
+}
+template <class Op_T, class Op_P> constexpr void insert_nud(PrattTable& table, std::size_t index, const Prefix<Op_T, Op_P>& op) {
+	table.insert(index, analyze_impl(op.p, OpaqueReferences()));
+}
+template <class Op> constexpr void insert_led(PrattTable& table, std::size_t index, const Op& op) {}
+template <class Op_T, class Op_P> constexpr void insert_led(PrattTable& table, std::size_t index, const InfixLTR<Op_T, Op_P>& op) {
+	table.insert(index, analyze_impl(op.p, OpaqueReferences()));
+}
+template <class Op_T, class Op_P> constexpr void insert_led(PrattTable& table, std::size_t index, const InfixRTL<Op_T, Op_P>& op) {
+	table.insert(index, analyze_impl(op.p, OpaqueReferences()));
+}
+template <class Op_T, class Op_P> constexpr void insert_led(PrattTable& table, std::size_t index, const Postfix<Op_T, Op_P>& op) {
+	table.insert(index, analyze_impl(op.p, OpaqueReferences()));
+}
+
+constexpr std::size_t insert_operators(PrattTable& nud_table, PrattTable& led_table, std::size_t index, const PrattLevel<>& op) {
+	return index;
+}
+template <class Op0, class... Op> constexpr std::size_t insert_operators(PrattTable& nud_table, PrattTable& led_table, std::size_t index, const PrattLevel<Op0, Op...>& op) {
+	insert_nud(nud_table, index, op.head);
+	insert_led(led_table, index, op.head);
+	return insert_operators(nud_table, led_table, index + 1, op.tail);
+}
+constexpr void insert_operators(PrattTable& nud_table, PrattTable& led_table, std::size_t index, const PrattLevels<>& level) {}
+template <class L0, class... L> constexpr void insert_operators(PrattTable& nud_table, PrattTable& led_table, std::size_t index, const PrattLevels<L0, L...>& level) {
+	insert_operators(nud_table, led_table, insert_operators(nud_table, led_table, index, level.head), level.tail);
+}
+
+template <class... P> constexpr PrattTable get_nud_table(const PrattLevels<P...>& levels) {
+	PrattTable nud_table;
+	PrattTable led_table;
+	insert_operators(nud_table, led_table, 0, levels);
+	return nud_table;
+}
+template <class... P> constexpr PrattTable get_led_table(const PrattLevels<P...>& levels) {
+	PrattTable nud_table;
+	PrattTable led_table;
+	insert_operators(nud_table, led_table, 0, levels);
+	return led_table;
+}
+
+// W is the trivia (white space, comments) that is skipped between operands and operators
+template <class T, class W, class... P> class Pratt {
+public:
+	Trivia<W> trivia;
+	PrattLevels<P...> levels;
+	PrattTable nud_table;
+	PrattTable led_table;
+	constexpr Pratt(Trivia<W> trivia, P... p): trivia(trivia), levels(p...), nud_table(get_nud_table(levels)), led_table(get_led_table(levels)) {}
+};
+
+template <class T, class W, class... P> struct pratt_operator_count<Pratt<T, W, P...>>: pratt_operator_count<PrattLevels<P...>> {};
+
+// the collector of a level of a Pratt parser
+template <class P> struct pratt_collector;
+template <class T, class W, class... P> struct pratt_collector<Pratt<T, W, P...>> {
+	using type = T;
 };
 
+// the index of the first operator in op within the whole Pratt parser P, where level is the PrattLevels op belongs to
+template <class P, class L, class Op> constexpr std::size_t get_operator_index() {
+	return pratt_operator_count<P>::value - pratt_operator_count<Op>::value - pratt_operator_count<decltype(L::tail)>::value;
+}
+
 template <class P> constexpr Terminal<P> terminal(P p) {
 	return Terminal<P>(p);
 }
@@ -76,42 +189,203 @@ template <class T, class P> constexpr Postfix<T, P> postfix(P p) {
 template <class... P> constexpr PrattLevel<P...> pratt_level(P... p) {
 	return PrattLevel<P...>(p...);
 }
-template <class T, class... P> constexpr Pratt<T, P...> pratt(P... p) {
-	return Pratt<T, P...>(p...);
+template <class P> constexpr Trivia<P> trivia(P p) {
+	return Trivia<P>(p);
+}
+template <class T, class... P> constexpr Pratt<T, Sequence<>, P...> pratt(P... p) {
+	return Pratt<T, Sequence<>, P...>(Trivia<Sequence<>>(Sequence<>()), p...);
+}
+template <class T, class W, class... P> constexpr Pratt<T, W, P...> pratt(Trivia<W> trivia, P... p) {
+	return Pratt<T, W, P...>(trivia, p...);
+}
+
+// collectors for the result of a Pratt level and of an operator
+template <class T, class C> class PrattCollector {
+	T collector;
+public:
+	PrattCollector(const C& callback) {}
+	CollectCallback<T> get_callback() {
+		return CollectCallback<T>(collector);
+	}
+	void set_location(const SourceLocation& location) {
+		collector.set_location(location);
+	}
+	void retrieve(const C& callback) {
+		collector.retrieve(callback);
+	}
+};
+template <class T, class C> class PrattOperatorCollector {
+	T collector;
+public:
+	PrattOperatorCollector(const C& callback) {}
+	CollectCallback<T> get_callback() {
+		return CollectCallback<T>(collector);
+	}
+	// the callback for the operator itself
+	CollectCallback<T> get_operator_callback() {
+		return CollectCallback<T>(collector);
+	}
+	void set_location(const SourceLocation& location) {}
+	void retrieve(const C& callback) {
+		collector.retrieve(callback);
+	}
+};
+
+// flat output mode: instead of collecting every level and operator, operands and operators are appended to a single
+// buffer in postfix order; operands are whatever the terminals push, operators are pushed as (Tag<T>, SourceLocation)
+// where T is the operator's collector type and the location is the location of the operator itself, anything the operator's
+// own parser would push is ignored
+template <class I> class PostfixCallback {
+	std::vector<I>& instructions;
+public:
+	PostfixCallback(std::vector<I>& instructions): instructions(instructions) {}
+	template <class... A> void push(A&&... a) const {
+		instructions.emplace_back(std::forward<A>(a)...);
+	}
+	void set_location(const SourceLocation& location) const {}
+	std::size_t save() const {
+		return instructions.size();
+	}
+	void restore(std::size_t save_point) const {
+		instructions.erase(instructions.begin() + save_point, instructions.end());
+	}
+};
+template <class T, class I> class PrattCollector<T, PostfixCallback<I>> {
+	const PostfixCallback<I>& callback;
+	std::size_t save_point;
+	bool retrieved;
+public:
+	PrattCollector(const PostfixCallback<I>& callback): callback(callback), save_point(callback.save()), retrieved(false) {}
+	PrattCollector(const PrattCollector&) = delete;
+	~PrattCollector() {
+		// discard the instructions of a failed parse
+		if (!retrieved) {
+			callback.restore(save_point);
+		}
+	}
+	PrattCollector& operator =(const PrattCollector&) = delete;
+	const PostfixCallback<I>& get_callback() const {
+		return callback;
+	}
+	void set_location(const SourceLocation& location) {}
+	void retrieve(const PostfixCallback<I>& callback) {
+		retrieved = true;
+	}
+};
+template <class T, class I> class PrattOperatorCollector<T, PostfixCallback<I>> {
+	const PostfixCallback<I>& callback;
+	std::size_t save_point;
+	SourceLocation location;
+	bool retrieved;
+public:
+	PrattOperatorCollector(const PostfixCallback<I>& callback): callback(callback), save_point(callback.save()), retrieved(false) {}
+	PrattOperatorCollector(const PrattOperatorCollector&) = delete;
+	~PrattOperatorCollector() {
+		if (!retrieved) {
+			callback.restore(save_point);
+		}
+	}
+	PrattOperatorCollector& operator =(const PrattOperatorCollector&) = delete;
+	const PostfixCallback<I>& get_callback() const {
+		return callback;
+	}
+	// the operator is represented by its tag, so whatever its parser pushes is ignored
+	Ignore get_operator_callback() const {
+		return Ignore();
+	}
+	void set_location(const SourceLocation& location) {
+		this->location = location;
+	}
+	void retrieve(const PostfixCallback<I>& callback) {
+		callback.push(Tag<T>(), location);
+		retrieved = true;
+	}
+};
+
+// after an operand the same trivia is skipped once per nesting level, so the last result is cached for the duration of a parse
+class TriviaCache {
+public:
+	SavePoint begin;
+	SavePoint end;
+	TriviaCache(): begin(nullptr), end(nullptr) {}
+};
+
+// operands are parsed recursively, their nesting is limited by Context::set_max_depth
+template <class P, class L, class C> Result parse_operand(const P& pratt, const L& level, Context& context, TriviaCache& trivia_cache, const C& callback) {
+	if (!context.increase_depth()) {
+		return ERROR;
+	}
+	const Result result = parse_pratt(pratt, level, context, trivia_cache, callback);
+	context.decrease_depth();
+	return result;
+}
+
+// parse_trivia
+inline Result parse_trivia(const Trivia<Sequence<>>& trivia, Context& context, TriviaCache& trivia_cache) {
+	return SUCCESS;
+}
+template <class W> Result parse_trivia_slow(const Trivia<W>& trivia, Context& context, TriviaCache& trivia_cache) {
+	const SavePoint save_point = context.save();
+	if (parse_impl(trivia.p, context, Ignore()) == ERROR) {
+		return ERROR;
+	}
+	trivia_cache.begin = save_point;
+	trivia_cache.end = context.save();
+	return SUCCESS;
+}
+template <class W> inline Result parse_trivia(const Trivia<W>& trivia, Context& context, TriviaCache& trivia_cache) {
+	if (context.has_input() && !trivia.first.contains(*context)) {
+		return SUCCESS;
+	}
+	if (trivia_cache.begin == context.save()) {
+		context.restore(trivia_cache.end);
+		return SUCCESS;
+	}
+	return parse_trivia_slow(trivia, context, trivia_cache);
 }
 
 // parse_nud
-template <class P, class L, class C> Result parse_nud(const P& pratt, const L& level, const PrattLevel<>& op, Context& context, const C& callback) {
+template <class P, class L, class C> Result parse_nud(const P& pratt, const L& level, const PrattLevel<>& op, Context& context, TriviaCache& trivia_cache, const C& callback, std::uint64_t candidates) {
 	// last operator; go to next level
-	return parse_nud(pratt, level.tail, context, callback);
+	return parse_nud(pratt, level.tail, context, trivia_cache, callback, candidates);
 }
-template <class P, class L, class Op0, class... Op, class C> Result parse_nud(const P& pratt, const L& level, const PrattLevel<Op0, Op...>& op, Context& context, const C& callback) {
+template <class P, class L, class Op0, class... Op, class C> Result parse_nud(const P& pratt, const L& level, const PrattLevel<Op0, Op...>& op, Context& context, TriviaCache& trivia_cache, const C& callback, std::uint64_t candidates) {
 	// skip irrelevant operators
-	return parse_nud(pratt, level, op.tail, context, callback);
+	return parse_nud(pratt, level, op.tail, context, trivia_cache, callback, candidates);
 }
-template <class P, class L, class Op_T, class... Op, class C> Result parse_nud(const P& pratt, const L& level, const PrattLevel<Terminal<Op_T>, Op...>& op, Context& context, const C& callback) {
+template <class P, class L, class Op_T, class... Op, class C> Result parse_nud(const P& pratt, const L& level, const PrattLevel<Terminal<Op_T>, Op...>& op, Context& context, TriviaCache& trivia_cache, const C& callback, std::uint64_t candidates) {
 	// Terminal
+	if (!PrattTable::contains(candidates, get_operator_index<P, L, PrattLevel<Terminal<Op_T>, Op...>>())) {
+		return parse_nud(pratt, level, op.tail, context, trivia_cache, callback, candidates);
+	}
 	const Result result = parse_impl(op.head.p, context, callback);
 	if (result == ERROR) {
 		return ERROR;
 	}
 	if (result == FAILURE) {
-		return parse_nud(pratt, level, op.tail, context, callback);
+		return parse_nud(pratt, level, op.tail, context, trivia_cache, callback, candidates);
 	}
 	return SUCCESS;
 }
-template <class P, class L, class Op_T, class Op_P, class... Op, class C> Result parse_nud(const P& pratt, const L& level, const PrattLevel<Prefix<Op_T, Op_P>, Op...>& op, Context& context, const C& callback) {
+template <class P, class L, class Op_T, class Op_P, class... Op, class C> Result parse_nud(const P& pratt, const L& level, const PrattLevel<Prefix<Op_T, Op_P>, Op...>& op, Context& context, TriviaCache& trivia_cache, const C& callback, std::uint64_t candidates) {
 	// Prefix
-	Op_T collector;
+	if (!PrattTable::contains(candidates, get_operator_index<P, L, PrattLevel<Prefix<Op_T, Op_P>, Op...>>())) {
+		return parse_nud(pratt, level, op.tail, context, trivia_cache, callback, candidates);
+	}
+	PrattOperatorCollector<Op_T, C> collector(callback);
 	const SavePoint save_point = context.save();
-	Result result = parse_impl(op.head.p, context, CollectCallback<Op_T>(collector));
+	Result result = parse_impl(op.head.p, context, collector.get_operator_callback());
 	if (result == ERROR) {
 		return ERROR;
 	}
 	if (result == FAILURE) {
-		return parse_nud(pratt, level, op.tail, context, callback);
+		return parse_nud(pratt, level, op.tail, context, trivia_cache, callback, candidates);
+	}
+	collector.set_location(context.get_location(save_point));
+	if (parse_trivia(pratt.trivia, context, trivia_cache) == ERROR) {
+		return ERROR;
 	}
-	result = parse_pratt(pratt, level, context, CollectCallback<Op_T>(collector));
+	result = parse_operand(pratt, level, context, trivia_cache, collector.get_callback());
 	if (result == ERROR) {
 		return ERROR;
 	}
@@ -123,34 +397,53 @@ template <class P, class L, class Op_T, class Op_P, class... Op, class C> Result
 	return SUCCESS;
 }
 
-template <class P, class L_T, class C> Result parse_nud(const P& pratt, const Pratt<L_T>& level, Context& context, const C& callback) {
+template <class P, class C> Result parse_nud(const P& pratt, const PrattLevels<>& level, Context& context, TriviaCache& trivia_cache, const C& callback, std::uint64_t candidates) {
 	return FAILURE;
 }
-template <class P, class L_T, class L0, class... L, class C> Result parse_nud(const P& pratt, const Pratt<L_T, L0, L...>& level, Context& context, const C& callback) {
-	return parse_nud(pratt, level, level.head, context, callback);
+template <class P, class L0, class... L, class C> Result parse_nud(const P& pratt, const PrattLevels<L0, L...>& level, Context& context, TriviaCache& trivia_cache, const C& callback, std::uint64_t candidates) {
+	return parse_nud(pratt, level, level.head, context, trivia_cache, callback, candidates);
+}
+template <class P, class L, class C> Result parse_nud(const P& pratt, const L& level, Context& context, TriviaCache& trivia_cache, const C& callback) {
+	// moves on to the next segment or waits for more input so that the table sees the next character
+	context.has_input();
+	const std::uint64_t candidates = pratt.nud_table.get(context);
+	if (pratt_operator_count<P>::value <= PrattTable::MAX_OPERATORS && candidates == 0) {
+		return FAILURE;
+	}
+	return parse_nud(pratt, level, context, trivia_cache, callback, candidates);
+}
+template <class T, class W, class... P, class C> Result parse_nud(const Pratt<T, W, P...>& pratt, Context& context, TriviaCache& trivia_cache, const C& callback) {
+	return parse_nud(pratt, pratt.levels, context, trivia_cache, callback);
 }
 
 // parse_led
-template <class P, class L, class C> Result parse_led(const P& pratt, const L& level, const PrattLevel<>& op, Context& context, const C& callback) {
+template <class P, class L, class C> Result parse_led(const P& pratt, const L& level, const PrattLevel<>& op, Context& context, TriviaCache& trivia_cache, const C& callback, std::uint64_t candidates) {
 	// last operator; go to next level
-	return parse_led(pratt, level.tail, context, callback);
+	return parse_led(pratt, level.tail, context, trivia_cache, callback, candidates);
 }
-template <class P, class L, class Op0, class... Op, class C> Result parse_led(const P& pratt, const L& level, const PrattLevel<Op0, Op...>& op, Context& context, const C& callback) {
+template <class P, class L, class Op0, class... Op, class C> Result parse_led(const P& pratt, const L& level, const PrattLevel<Op0, Op...>& op, Context& context, TriviaCache& trivia_cache, const C& callback, std::uint64_t candidates) {
 	// skip irrelevant operators
-	return parse_led(pratt, level, op.tail, context, callback);
+	return parse_led(pratt, level, op.tail, context, trivia_cache, callback, candidates);
 }
-template <class P, class L, class Op_T, class Op_P, class... Op, class C> Result parse_led(const P& pratt, const L& level, const PrattLevel<InfixLTR<Op_T, Op_P>, Op...>& op, Context& context, const C& callback) {
+template <class P, class L, class Op_T, class Op_P, class... Op, class C> Result parse_led(const P& pratt, const L& level, const PrattLevel<InfixLTR<Op_T, Op_P>, Op...>& op, Context& context, TriviaCache& trivia_cache, const C& callback, std::uint64_t candidates) {
 	// InfixLTR
-	Op_T collector;
+	if (!PrattTable::contains(candidates, get_operator_index<P, L, PrattLevel<InfixLTR<Op_T, Op_P>, Op...>>())) {
+		return parse_led(pratt, level, op.tail, context, trivia_cache, callback, candidates);
+	}
+	PrattOperatorCollector<Op_T, C> collector(callback);
 	const SavePoint save_point = context.save();
-	Result result = parse_impl(op.head.p, context, CollectCallback<Op_T>(collector));
+	Result result = parse_impl(op.head.p, context, collector.get_operator_callback());
 	if (result == ERROR) {
 		return ERROR;
 	}
 	if (result == FAILURE) {
-		return parse_led(pratt, level, op.tail, context, callback);
+		return parse_led(pratt, level, op.tail, context, trivia_cache, callback, candidates);
 	}
-	result = parse_pratt(pratt, level.tail, context, CollectCallback<Op_T>(collector));
+	collector.set_location(context.get_location(save_point));
+	if (parse_trivia(pratt.trivia, context, trivia_cache) == ERROR) {
+		return ERROR;
+	}
+	result = parse_operand(pratt, level.tail, context, trivia_cache, collector.get_callback());
 	if (result == ERROR) {
 		return ERROR;
 	}
@@ -161,18 +454,25 @@ template <class P, class L, class Op_T, class Op_P, class... Op, class C> Result
 	collector.retrieve(callback);
 	return SUCCESS;
 }
-template <class P, class L, class Op_T, class Op_P, class... Op, class C> Result parse_led(const P& pratt, const L& level, const PrattLevel<InfixRTL<Op_T, Op_P>, Op...>& op, Context& context, const C& callback) {
+template <class P, class L, class Op_T, class Op_P, class... Op, class C> Result parse_led(const P& pratt, const L& level, const PrattLevel<InfixRTL<Op_T, Op_P>, Op...>& op, Context& context, TriviaCache& trivia_cache, const C& callback, std::uint64_t candidates) {
 	// InfixRTL
-	Op_T collector;
+	if (!PrattTable::contains(candidates, get_operator_index<P, L, PrattLevel<InfixRTL<Op_T, Op_P>, Op...>>())) {
+		return parse_led(pratt, level, op.tail, context, trivia_cache, callback, candidates);
+	}
+	PrattOperatorCollector<Op_T, C> collector(callback);
 	const SavePoint save_point = context.save();
-	Result result = parse_impl(op.head.p, context, CollectCallback<Op_T>(collector));
+	Result result = parse_impl(op.head.p, context, collector.get_operator_callback());
 	if (result == ERROR) {
 		return ERROR;
 	}
 	if (result == FAILURE) {
-		return parse_led(pratt, level, op.tail, context, callback);
+		return parse_led(pratt, level, op.tail, context, trivia_cache, callback, candidates);
+	}
+	collector.set_location(context.get_location(save_point));
+	if (parse_trivia(pratt.trivia, context, trivia_cache) == ERROR) {
+		return ERROR;
 	}
-	result = parse_pratt(pratt, level, context, CollectCallback<Op_T>(collector));
+	result = parse_operand(pratt, level, context, trivia_cache, collector.get_callback());
 	if (result == ERROR) {
 		return ERROR;
 	}
@@ -183,31 +483,46 @@ template <class P, class L, class Op_T, class Op_P, class... Op, class C> Result
 	collector.retrieve(callback);
 	return SUCCESS;
 }
-template <class P, class L, class Op_T, class Op_P, class... Op, class C> Result parse_led(const P& pratt, const L& level, const PrattLevel<Postfix<Op_T, Op_P>, Op...>& op, Context& context, const C& callback) {
+template <class P, class L, class Op_T, class Op_P, class... Op, class C> Result parse_led(const P& pratt, const L& level, const PrattLevel<Postfix<Op_T, Op_P>, Op...>& op, Context& context, TriviaCache& trivia_cache, const C& callback, std::uint64_t candidates) {
 	// Postfix
-	Op_T collector;
-	const Result result = parse_impl(op.head.p, context, CollectCallback<Op_T>(collector));
+	if (!PrattTable::contains(candidates, get_operator_index<P, L, PrattLevel<Postfix<Op_T, Op_P>, Op...>>())) {
+		return parse_led(pratt, level, op.tail, context, trivia_cache, callback, candidates);
+	}
+	PrattOperatorCollector<Op_T, C> collector(callback);
+	const SavePoint save_point = context.save();
+	const Result result = parse_impl(op.head.p, context, collector.get_operator_callback());
 	if (result == ERROR) {
 		return ERROR;
 	}
 	if (result == FAILURE) {
-		return parse_led(pratt, level, op.tail, context, callback);
+		return parse_led(pratt, level, op.tail, context, trivia_cache, callback, candidates);
 	}
+	collector.set_location(context.get_location(save_point));
 	collector.retrieve(callback);
 	return SUCCESS;
 }
 
-template <class P, class L_T, class C> Result parse_led(const P& pratt, const Pratt<L_T>& level, Context& context, const C& callback) {
+template <class P, class C> Result parse_led(const P& pratt, const PrattLevels<>& level, Context& context, TriviaCache& trivia_cache, const C& callback, std::uint64_t candidates) {
 	return FAILURE;
 }
-template <class P, class L_T, class L0, class... L, class C> Result parse_led(const P& pratt, const Pratt<L_T, L0, L...>& level, Context& context, const C& callback) {
-	return parse_led(pratt, level, level.head, context, callback);
+template <class P, class L0, class... L, class C> Result parse_led(const P& pratt, const PrattLevels<L0, L...>& level, Context& context, TriviaCache& trivia_cache, const C& callback, std::uint64_t candidates) {
+	return parse_led(pratt, level, level.head, context, trivia_cache, callback, candidates);
+}
+template <class P, class L, class C> Result parse_led(const P& pratt, const L& level, Context& context, TriviaCache& trivia_cache, const C& callback) {
+	context.has_input();
+	// only operators of this level and the following levels bind tightly enough
+	const std::uint64_t candidates = pratt.led_table.get(context) & PrattTable::get_mask(pratt_operator_count<P>::value - pratt_operator_count<L>::value);
+	if (pratt_operator_count<P>::value <= PrattTable::MAX_OPERATORS && candidates == 0) {
+		return FAILURE;
+	}
+	return parse_led(pratt, level, context, trivia_cache, callback, candidates);
 }
 
-template <class T, class... P, class L, class C> Result parse_pratt(const Pratt<T, P...>& pratt, const L& level, Context& context, const C& callback) {
-	T collector;
+// the algorithm shared by Pratt and RuntimePratt, level determines which operators bind tightly enough to continue the expression
+template <class P, class L, class C> Result parse_pratt(const P& pratt, const L& level, Context& context, TriviaCache& trivia_cache, const C& callback) {
+	PrattCollector<typename pratt_collector<P>::type, C> collector(callback);
 	const SavePoint save_point = context.save();
-	const Result result = parse_nud(pratt, pratt, context, CollectCallback<T>(collector));
+	const Result result = parse_nud(pratt, context, trivia_cache, collector.get_callback());
 	if (result == ERROR) {
 		return ERROR;
 	}
@@ -216,11 +531,20 @@ template <class T, class... P, class L, class C> Result parse_pratt(const Pratt<
 	}
 	collector.set_location(context.get_location(save_point));
 	while (true) {
-		const Result result = parse_led(pratt, level, context, CollectCallback<T>(collector));
+		if (!context.step()) {
+			return ERROR;
+		}
+		const SavePoint trivia_save_point = context.save();
+		if (parse_trivia(pratt.trivia, context, trivia_cache) == ERROR) {
+			return ERROR;
+		}
+		const Result result = parse_led(pratt, level, context, trivia_cache, collector.get_callback());
 		if (result == ERROR) {
 			return ERROR;
 		}
 		if (result == FAILURE) {
+			// trailing trivia is not part of the expression
+			context.restore(trivia_save_point);
 			break;
 		}
 		collector.set_location(context.get_location(save_point));
@@ -228,8 +552,275 @@ template <class T, class... P, class L, class C> Result parse_pratt(const Pratt<
 	collector.retrieve(callback);
 	return SUCCESS;
 }
-template <class T, class... P, class C> Result parse_impl(const Pratt<T, P...>& p, Context& context, const C& callback) {
-	return parse_pratt(p, p, context, callback);
+template <class T, class W, class... P, class C> Result parse_impl(const Pratt<T, W, P...>& p, Context& context, const C& callback) {
+	TriviaCache trivia_cache;
+	return parse_pratt(p, p.levels, context, trivia_cache, callback);
+}
+
+// analyze
+template <class V> constexpr GrammarInfo analyze_nud(const PrattLevel<>& op, V v) {
+	return GrammarInfo::fail();
+}
+template <class Op0, class... Op, class V> constexpr GrammarInfo analyze_nud(const PrattLevel<Op0, Op...>& op, V v) {
+	return analyze_nud(op.tail, v);
+}
+template <class Op_P, class... Op, class V> constexpr GrammarInfo analyze_nud(const PrattLevel<Terminal<Op_P>, Op...>& op, V v) {
+	return analyze_impl(op.head.p, v).or_(analyze_nud(op.tail, v));
+}
+template <class Op_T, class Op_P, class... Op, class V> constexpr GrammarInfo analyze_nud(const PrattLevel<Prefix<Op_T, Op_P>, Op...>& op, V v) {
+	// a prefix operator that does not consume any input recurses forever
+	const GrammarInfo info = analyze_impl(op.head.p, v);
+	return info.with_infinite_loop(info.nullable).or_(analyze_nud(op.tail, v));
+}
+
+template <class V> constexpr GrammarInfo analyze_led(const PrattLevel<>& op, V v) {
+	return GrammarInfo::fail();
+}
+template <class Op0, class... Op, class V> constexpr GrammarInfo analyze_led(const PrattLevel<Op0, Op...>& op, V v) {
+	return analyze_led(op.tail, v);
+}
+template <class Op_T, class Op_P, class... Op, class V> constexpr GrammarInfo analyze_led(const PrattLevel<InfixLTR<Op_T, Op_P>, Op...>& op, V v) {
+	return analyze_impl(op.head.p, v).or_(analyze_led(op.tail, v));
+}
+template <class Op_T, class Op_P, class... Op, class V> constexpr GrammarInfo analyze_led(const PrattLevel<InfixRTL<Op_T, Op_P>, Op...>& op, V v) {
+	return analyze_impl(op.head.p, v).or_(analyze_led(op.tail, v));
+}
+template <class Op_T, class Op_P, class... Op, class V> constexpr GrammarInfo analyze_led(const PrattLevel<Postfix<Op_T, Op_P>, Op...>& op, V v) {
+	// a postfix operator that does not consume any input loops forever
+	const GrammarInfo info = analyze_impl(op.head.p, v);
+	return info.with_infinite_loop(info.nullable).or_(analyze_led(op.tail, v));
+}
+
+template <class V> constexpr GrammarInfo analyze_nud(const PrattLevels<>& level, V v) {
+	return GrammarInfo::fail();
+}
+template <class L0, class... L, class V> constexpr GrammarInfo analyze_nud(const PrattLevels<L0, L...>& level, V v) {
+	return analyze_nud(level.head, v).or_(analyze_nud(level.tail, v));
+}
+template <class V> constexpr GrammarInfo analyze_led(const PrattLevels<>& level, V v) {
+	return GrammarInfo::fail();
+}
+template <class L0, class... L, class V> constexpr GrammarInfo analyze_led(const PrattLevels<L0, L...>& level, V v) {
+	return analyze_led(level.head, v).or_(analyze_led(level.tail, v));
+}
+
+template <class T, class W, class... P, class V> constexpr GrammarInfo analyze_impl(const Pratt<T, W, P...>& p, V v) {
+	// operators are analyzed on their own since a failing operand never causes the next operator to be tried
+	const GrammarInfo operand(false, CharSet(), 1, GrammarInfo::UNBOUNDED);
+	const GrammarInfo trivia = analyze_impl(p.trivia.p, v);
+	return analyze_nud(p.levels, v).then(trivia.then(analyze_led(p.levels, v)).then(trivia).then(operand).repeated());
+}
+
+// runtime Pratt parser
+// the operators are read from an OperatorTable that can be changed between parses, the operand parser P is parsed
+// like a terminal; T collects a level like in Pratt and receives (const Operator<O>&, V) for prefix and infix operators
+// and (const Operator<O>&) for postfix operators, where V is the value T retrieves
+enum OperatorType: char {
+	PREFIX,
+	INFIX_LTR,
+	INFIX_RTL,
+	POSTFIX
+};
+
+template <class O> class Operator {
+public:
+	O value;
+	OperatorType type;
+	// operators with a higher binding power bind more tightly, like later levels in Pratt
+	unsigned int binding_power;
+	Operator(const O& value, OperatorType type, unsigned int binding_power): value(value), type(type), binding_power(binding_power) {}
+};
+
+template <class O> class OperatorTable {
+	class Entry {
+	public:
+		std::string literal;
+		Index nud;
+		Index led;
+		Entry(const StringView& literal): literal(literal.to_string()) {}
+	};
+	std::vector<Operator<O>> operators;
+	// the slots in operators that belonged to removed operators and can be reused
+	std::vector<std::size_t> free_operators;
+	// entries are hashed by their first character and sorted by decreasing length so that the longest literal wins
+	std::vector<Entry> buckets[256];
+	static unsigned int get_bucket(char c) {
+		return static_cast<unsigned char>(c);
+	}
+	// the entry for literal or the position at which it has to be inserted
+	typename std::vector<Entry>::iterator find_entry(std::vector<Entry>& bucket, const StringView& literal) {
+		auto i = bucket.begin();
+		while (i != bucket.end() && i->literal.size() > literal.size()) {
+			++i;
+		}
+		for (auto j = i; j != bucket.end() && j->literal.size() == literal.size(); ++j) {
+			if (StringView(j->literal) == literal) {
+				return j;
+			}
+		}
+		return i;
+	}
+	void add(const StringView& literal, const O& value, OperatorType type, unsigned int binding_power) {
+		if (literal.empty()) {
+			return;
+		}
+		std::vector<Entry>& bucket = buckets[get_bucket(literal[0])];
+		auto i = find_entry(bucket, literal);
+		if (i == bucket.end() || StringView(i->literal) != literal) {
+			i = bucket.insert(i, Entry(literal));
+		}
+		Index& index = type == PREFIX ? i->nud : i->led;
+		if (index) {
+			operators[*index] = Operator<O>(value, type, binding_power);
+		}
+		else if (!free_operators.empty()) {
+			index = free_operators.back();
+			free_operators.pop_back();
+			operators[*index] = Operator<O>(value, type, binding_power);
+		}
+		else {
+			index = operators.size();
+			operators.emplace_back(value, type, binding_power);
+		}
+	}
+	template <class F> const Operator<O>* match(Context& context, F f) const {
+		if (!context.has_input()) {
+			return nullptr;
+		}
+		for (const Entry& entry: buckets[get_bucket(*context)]) {
+			const Index index = f(entry);
+			if (index && parse_impl(StringView(entry.literal), context, Ignore()) == SUCCESS) {
+				return &operators[*index];
+			}
+		}
+		return nullptr;
+	}
+public:
+	void add_prefix(const StringView& literal, unsigned int binding_power, const O& value) {
+		add(literal, value, PREFIX, binding_power);
+	}
+	void add_infix_ltr(const StringView& literal, unsigned int binding_power, const O& value) {
+		add(literal, value, INFIX_LTR, binding_power);
+	}
+	void add_infix_rtl(const StringView& literal, unsigned int binding_power, const O& value) {
+		add(literal, value, INFIX_RTL, binding_power);
+	}
+	void add_postfix(const StringView& literal, unsigned int binding_power, const O& value) {
+		add(literal, value, POSTFIX, binding_power);
+	}
+	// removes the prefix and the infix or postfix operator with the given literal
+	void remove(const StringView& literal) {
+		if (literal.empty()) {
+			return;
+		}
+		std::vector<Entry>& bucket = buckets[get_bucket(literal[0])];
+		auto i = find_entry(bucket, literal);
+		if (i == bucket.end() || StringView(i->literal) != literal) {
+			return;
+		}
+		if (i->nud) {
+			free_operators.push_back(*i->nud);
+		}
+		if (i->led) {
+			free_operators.push_back(*i->led);
+		}
+		bucket.erase(i);
+	}
+	// on success the context is advanced past the operator
+	const Operator<O>* match_nud(Context& context) const {
+		return match(context, [](const Entry& entry) {
+			return entry.nud;
+		});
+	}
+	const Operator<O>* match_led(Context& context) const {
+		return match(context, [](const Entry& entry) {
+			return entry.led;
+		});
+	}
+};
+
+template <class T, class V, class O, class W, class P> class RuntimePratt {
+public:
+	const OperatorTable<O>* table;
+	Trivia<W> trivia;
+	P p;
+	constexpr RuntimePratt(const OperatorTable<O>* table, Trivia<W> trivia, P p): table(table), trivia(trivia), p(p) {}
+};
+
+template <class T, class V, class O, class W, class P> struct pratt_collector<RuntimePratt<T, V, O, W, P>> {
+	using type = T;
+};
+
+template <class T, class V, class O, class P> constexpr RuntimePratt<T, V, O, Sequence<>, P> runtime_pratt(const OperatorTable<O>& table, P p) {
+	return RuntimePratt<T, V, O, Sequence<>, P>(&table, Trivia<Sequence<>>(Sequence<>()), p);
+}
+template <class T, class V, class O, class W, class P> constexpr RuntimePratt<T, V, O, W, P> runtime_pratt(const OperatorTable<O>& table, Trivia<W> trivia, P p) {
+	return RuntimePratt<T, V, O, W, P>(&table, trivia, p);
+}
+
+template <class T, class V, class O, class W, class P, class C> Result parse_nud(const RuntimePratt<T, V, O, W, P>& pratt, Context& context, TriviaCache& trivia_cache, const C& callback) {
+	const SavePoint save_point = context.save();
+	const Operator<O>* op = pratt.table->match_nud(context);
+	if (op == nullptr) {
+		return parse_impl(pratt.p, context, callback);
+	}
+	if (parse_trivia(pratt.trivia, context, trivia_cache) == ERROR) {
+		return ERROR;
+	}
+	V operand;
+	const Result result = parse_operand(pratt, op->binding_power, context, trivia_cache, GetValueCallback<V>(operand));
+	if (result == ERROR) {
+		return ERROR;
+	}
+	if (result == FAILURE) {
+		context.restore(save_point);
+		return FAILURE;
+	}
+	callback.push(*op, std::move(operand));
+	return SUCCESS;
+}
+
+template <class T, class V, class O, class W, class P, class C> Result parse_led(const RuntimePratt<T, V, O, W, P>& pratt, unsigned int binding_power, Context& context, TriviaCache& trivia_cache, const C& callback) {
+	const SavePoint save_point = context.save();
+	const Operator<O>* op = pratt.table->match_led(context);
+	if (op == nullptr) {
+		return FAILURE;
+	}
+	if (op->binding_power < binding_power) {
+		context.restore(save_point);
+		return FAILURE;
+	}
+	if (op->type == POSTFIX) {
+		callback.push(*op);
+		return SUCCESS;
+	}
+	if (parse_trivia(pratt.trivia, context, trivia_cache) == ERROR) {
+		return ERROR;
+	}
+	V operand;
+	const Result result = parse_operand(pratt, op->type == INFIX_LTR ? op->binding_power + 1 : op->binding_power, context, trivia_cache, GetValueCallback<V>(operand));
+	if (result == ERROR) {
+		return ERROR;
+	}
+	if (result == FAILURE) {
+		context.restore(save_point);
+		return FAILURE;
+	}
+	callback.push(*op, std::move(operand));
+	return SUCCESS;
+}
+
+template <class T, class V, class O, class W, class P, class C> Result parse_impl(const RuntimePratt<T, V, O, W, P>& p, Context& context, const C& callback) {
+	TriviaCache trivia_cache;
+	return parse_pratt(p, 0u, context, trivia_cache, callback);
+}
+
+template <class T, class V, class O, class W, class P, class Vi> constexpr GrammarInfo analyze_impl(const RuntimePratt<T, V, O, W, P>& p, Vi v) {
+	// operators are non-empty literals that are only known at runtime
+	const GrammarInfo op(false, CharSet::all(), 1, 1);
+	const GrammarInfo operand(false, CharSet(), 1, GrammarInfo::UNBOUNDED);
+	const GrammarInfo trivia = analyze_impl(p.trivia.p, v);
+	return op.or_(analyze_impl(p.p, v)).then(trivia.then(op).then(trivia).then(operand).repeated());
 }
 
 }
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "os.hpp"
+#include <memory>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// opens and reads files on a background thread while the previous files are parsed, so that a job over many files does not alternate between waiting for I/O and parsing
+// at most depth files are kept open ahead of the file that is being parsed
+class FilePrefetcher {
+	std::vector<std::string> paths;
+	std::size_t depth;
+	unsigned int flags;
+	std::deque<std::unique_ptr<MemoryMappedFile>> files;
+	std::size_t next_index;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopped;
+	std::thread thread;
+	void run() {
+		for (const std::string& path: paths) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]() {
+					return files.size() < depth || stopped;
+				});
+				if (stopped) {
+					return;
+				}
+			}
+			// the file is read without holding the lock
+			std::unique_ptr<MemoryMappedFile> file(new MemoryMappedFile(path.c_str(), flags));
+			std::lock_guard<std::mutex> lock(mutex);
+			files.push_back(std::move(file));
+			condition.notify_all();
+		}
+	}
+public:
+	// by default the files are read completely before they are returned, see MemoryMappedFile::POPULATE
+	FilePrefetcher(std::vector<std::string> paths, std::size_t depth = 4, unsigned int flags = MemoryMappedFile::POPULATE): paths(std::move(paths)), depth(depth > 0 ? depth : 1), flags(flags), next_index(0), stopped(false) {
+		thread = std::thread([this]() {
+			run();
+		});
+	}
+	FilePrefetcher(const FilePrefetcher&) = delete;
+	~FilePrefetcher() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopped = true;
+			condition.notify_all();
+		}
+		thread.join();
+	}
+	FilePrefetcher& operator =(const FilePrefetcher&) = delete;
+	std::size_t size() const {
+		return paths.size();
+	}
+	// the path of the file that was returned by the last call to next()
+	const std::string& get_path() const {
+		return paths[next_index - 1];
+	}
+	// the next file in the order of the paths or nullptr after the last one, waits until the file has been read
+	// a file that could not be opened is returned as an invalid MemoryMappedFile
+	std::unique_ptr<MemoryMappedFile> next() {
+		if (next_index == paths.size()) {
+			return nullptr;
+		}
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [this]() {
+			return !files.empty();
+		});
+		std::unique_ptr<MemoryMappedFile> file = std::move(files.front());
+		files.pop_front();
+		++next_index;
+		condition.notify_all();
+		return file;
+	}
+};
@@ -2,6 +2,11 @@
 
 #include "common.hpp"
 #include "os.hpp"
+#include <map>
+#include <memory>
+
+// a format string literal whose placeholders are found at compile time and checked against the arguments of format
+#define FORMAT_STRING(s) ([]() { struct S { static constexpr const char* get() { return s; } }; return printer::FormatString<S>(); }())
 
 namespace printer {
 
@@ -9,6 +14,12 @@ class Context {
 	BufferedOutput& output;
 	unsigned int indentation = 0;
 	bool is_at_bol = true;
+	void indent() {
+		if (is_at_bol) {
+			output.fill('\t', indentation);
+			is_at_bol = false;
+		}
+	}
 public:
 	Context(BufferedOutput& output = StandardOutput::get()): output(output) {}
 	void print(char c) {
@@ -17,15 +28,38 @@ public:
 			is_at_bol = true;
 		}
 		else {
-			if (is_at_bol) {
-				for (unsigned int i = 0; i < indentation; ++i) {
-					output.write('\t');
-				}
-				is_at_bol = false;
-			}
+			indent();
 			output.write(c);
 		}
 	}
+	// prints whole lines at once, empty lines are not indented
+	void print(const StringView& s) {
+		const char* position = s.begin();
+		while (position != s.end()) {
+			const void* newline = std::memchr(position, '\n', s.end() - position);
+			const char* line_end = newline ? static_cast<const char*>(newline) + 1 : s.end();
+			if (*position != '\n') {
+				indent();
+			}
+			output.write(position, line_end - position);
+			if (newline) {
+				is_at_bol = true;
+			}
+			position = line_end;
+		}
+	}
+	void print(char c, std::size_t count) {
+		if (count == 0) {
+			return;
+		}
+		if (c == '\n') {
+			is_at_bol = true;
+		}
+		else {
+			indent();
+		}
+		output.fill(c, count);
+	}
 	void increase_indentation() {
 		++indentation;
 	}
@@ -42,9 +76,7 @@ inline void print_impl(char c, Context& context) {
 }
 
 inline void print_impl(const StringView& s, Context& context) {
-	for (char c: s) {
-		context.print(c);
-	}
+	context.print(s);
 }
 
 inline void print_impl(const char* s, Context& context) {
@@ -57,6 +89,22 @@ template <class P> enable_if_t<is_printer<P>::value> print_impl(const P& p, Cont
 	p.print(context);
 }
 
+// the number of characters that a printer prints without indentation, for the printers that can compute it without printing
+inline std::size_t get_width_impl(char c) {
+	return 1;
+}
+inline std::size_t get_width_impl(const StringView& s) {
+	return s.size();
+}
+inline std::size_t get_width_impl(const char* s) {
+	return std::strlen(s);
+}
+template <class P> auto get_width_impl(const P& p) -> decltype(static_cast<std::size_t>(p.get_width())) {
+	return p.get_width();
+}
+template <class P, class = void> struct has_width: std::false_type {};
+template <class P> struct has_width<P, void_t<decltype(get_width_impl(std::declval<const P&>()))>>: std::true_type {};
+
 template <class P> class Ln {
 	P p;
 public:
@@ -65,6 +113,9 @@ public:
 		print_impl(p, context);
 		context.print('\n');
 	}
+	template <class Q = P> auto get_width() const -> decltype(get_width_impl(std::declval<const Q&>())) {
+		return get_width_impl(p) + 1;
+	}
 };
 template <class P> constexpr Ln<P> ln(P p) {
 	return Ln<P>(p);
@@ -94,6 +145,9 @@ public:
 	void print(Context& context) const {
 		print_impl(*p, context);
 	}
+	template <class Q = P> auto get_width() const -> decltype(get_width_impl(std::declval<const Q&>())) {
+		return get_width_impl(*p);
+	}
 };
 template <class P> constexpr Reference_<P> ref(const P& p) {
 	return Reference_<P>(p);
@@ -111,13 +165,93 @@ template <class F> constexpr PrintFunctor<F> print_functor(F f) {
 	return PrintFunctor<F>(f);
 }
 
+// the position of the next % in a format string that is not part of an escaped %%, or the end of the string
+constexpr std::size_t find_placeholder(const char* s, std::size_t i) {
+	while (s[i] != '\0') {
+		if (s[i] == '%') {
+			if (s[i + 1] != '%') {
+				return i;
+			}
+			++i;
+		}
+		++i;
+	}
+	return i;
+}
+// the position of the next escaped %% in a range without placeholders, or the end of the range
+constexpr std::size_t find_escape(const char* s, std::size_t begin, std::size_t end) {
+	while (begin != end && s[begin] != '%') {
+		++begin;
+	}
+	return begin;
+}
+constexpr std::size_t count_placeholders(const char* s) {
+	std::size_t count = 0;
+	for (std::size_t i = find_placeholder(s, 0); s[i] != '\0'; i = find_placeholder(s, i + 1)) {
+		++count;
+	}
+	return count;
+}
+// the number of characters that a format string prints itself
+constexpr std::size_t get_literal_width(const char* s) {
+	std::size_t width = 0;
+	for (std::size_t i = 0; s[i] != '\0'; ++i) {
+		if (s[i] == '%') {
+			if (s[i + 1] != '%') {
+				continue;
+			}
+			++i;
+		}
+		++width;
+	}
+	return width;
+}
+
+// a format string that is known at compile time, S::get() returns it, see FORMAT_STRING
+template <class S> class FormatString {
+	template <std::size_t begin, std::size_t end> static void print_literal(Context& context, std::false_type) {
+		context.print(StringView(S::get() + begin, end - begin));
+	}
+	template <std::size_t begin, std::size_t end> static void print_literal(Context& context, std::true_type) {
+		// the text up to and including the first % of an escaped %%
+		constexpr std::size_t escape = find_escape(S::get(), begin, end);
+		context.print(StringView(S::get() + begin, escape + 1 - begin));
+		print_literal<escape + 2, end>(context);
+	}
+public:
+	static constexpr const char* get() {
+		return S::get();
+	}
+	// prints the text from begin to end in as few pieces as possible
+	template <std::size_t begin, std::size_t end> static void print_literal(Context& context) {
+		print_literal<begin, end>(context, std::integral_constant<bool, (find_escape(S::get(), begin, end) < end)>());
+	}
+	static constexpr std::size_t get_length() {
+		return StringView(S::get()).size();
+	}
+};
+
 template <class... T> class PrintTuple;
 template <> class PrintTuple<> {
 public:
 	constexpr PrintTuple() {}
 	void print(Context& context) const {}
+	std::size_t get_width() const {
+		return 0;
+	}
 	void print_formatted(Context& context, const char* s) const {
-		print_impl(s, context);
+		while (*s) {
+			const char* percent = std::strchr(s, '%');
+			if (percent == nullptr) {
+				print_impl(s, context);
+				return;
+			}
+			context.print(StringView(s, percent - s + 1));
+			s = percent + (percent[1] == '%' ? 2 : 1);
+		}
+	}
+	template <class S, std::size_t begin> void print_formatted(Context& context) const {
+		S::template print_literal<begin, S::get_length()>(context);
 	}
 };
 template <class T0, class... T> class PrintTuple<T0, T...> {
@@ -129,20 +263,33 @@ public:
 		print_impl(t0, context);
 		t.print(context);
 	}
+	template <class Q0 = T0, class Q = PrintTuple<T...>> auto get_width() const -> decltype(get_width_impl(std::declval<const Q0&>()) + std::declval<const Q&>().get_width()) {
+		return get_width_impl(t0) + t.get_width();
+	}
 	void print_formatted(Context& context, const char* s) const {
 		while (*s) {
-			if (*s == '%') {
-				++s;
-				if (*s != '%') {
-					print_impl(t0, context);
-					t.print_formatted(context, s);
-					return;
-				}
+			const char* percent = std::strchr(s, '%');
+			if (percent == nullptr) {
+				print_impl(s, context);
+				return;
+			}
+			if (percent[1] != '%') {
+				context.print(StringView(s, percent - s));
+				print_impl(t0, context);
+				t.print_formatted(context, percent + 1);
+				return;
 			}
-			context.print(*s);
-			++s;
+			context.print(StringView(s, percent - s + 1));
+			s = percent + 2;
 		}
 	}
+	// the positions of the placeholders are computed at compile time
+	template <class S, std::size_t begin> void print_formatted(Context& context) const {
+		constexpr std::size_t placeholder = find_placeholder(S::get(), begin);
+		S::template print_literal<begin, placeholder>(context);
+		print_impl(t0, context);
+		t.template print_formatted<S, placeholder + 1>(context);
+	}
 };
 template <class... T> constexpr PrintTuple<T...> print_tuple(T... t) {
 	return PrintTuple<T...>(t...);
@@ -161,63 +308,144 @@ template <class... T> constexpr Format<T...> format(const char* s, T... t) {
 	return Format<T...>(s, t...);
 }
 
+template <class S, class... T> class StaticFormat {
+	PrintTuple<T...> t;
+public:
+	constexpr StaticFormat(T... t): t(t...) {}
+	void print(Context& context) const {
+		t.template print_formatted<FormatString<S>, 0>(context);
+	}
+	template <class Q = PrintTuple<T...>> auto get_width() const -> decltype(std::declval<const Q&>().get_width()) {
+		constexpr std::size_t literal_width = get_literal_width(S::get());
+		return literal_width + t.get_width();
+	}
+};
+template <class S, class... T> constexpr StaticFormat<S, T...> format(FormatString<S>, T... t) {
+	static_assert(count_placeholders(S::get()) == sizeof...(T), "the number of placeholders in the format string does not match the number of arguments");
+	return StaticFormat<S, T...>(t...);
+}
+
 class Number {
-	unsigned int n;
+	std::uint64_t n;
+	bool negative;
+	static const char* get_digit_pairs() {
+		return
+			"00010203040506070809"
+			"10111213141516171819"
+			"20212223242526272829"
+			"30313233343536373839"
+			"40414243444546474849"
+			"50515253545556575859"
+			"60616263646566676869"
+			"70717273747576777879"
+			"80818283848586878889"
+			"90919293949596979899";
+	}
 public:
-	constexpr Number(unsigned int n): n(n) {}
+	constexpr Number(std::uint64_t n, bool negative = false): n(n), negative(negative) {}
 	void print(Context& context) const {
-		if (n >= 10) {
-			Number(n / 10).print(context);
+		// the digits are written from the end, two at a time
+		char buffer[21];
+		char* end = buffer + sizeof(buffer);
+		char* p = end;
+		std::uint64_t m = n;
+		while (m >= 100) {
+			p -= 2;
+			std::memcpy(p, get_digit_pairs() + m % 100 * 2, 2);
+			m /= 100;
+		}
+		if (m >= 10) {
+			p -= 2;
+			std::memcpy(p, get_digit_pairs() + m * 2, 2);
+		}
+		else {
+			--p;
+			*p = static_cast<char>('0' + m);
+		}
+		if (negative) {
+			--p;
+			*p = '-';
 		}
-		context.print(static_cast<char>('0' + n % 10));
+		context.print(StringView(p, end - p));
 	}
 	unsigned int get_width() const {
-		unsigned int width = 0;
-		if (n >= 10) {
-			width += Number(n / 10).get_width();
-		}
-		return width + 1;
+		static constexpr std::uint64_t powers_of_10[] = {
+			1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+			10000000000, 100000000000, 1000000000000, 10000000000000, 100000000000000, 1000000000000000,
+			10000000000000000, 100000000000000000, 1000000000000000000, 10000000000000000000u
+		};
+		// an estimate of the number of digits from the number of bits, which is either correct or one too low
+		const std::uint64_t m = n | 1;
+		const unsigned int digits = (64 - count_leading_zeros(m)) * 1233 >> 12;
+		return digits + (m >= powers_of_10[digits]) + negative;
 	}
 };
-constexpr Number print_number(unsigned int n) {
+template <class T> constexpr enable_if_t<std::is_unsigned<T>::value, Number> print_number(T n) {
 	return Number(n);
 }
+template <class T> constexpr enable_if_t<std::is_signed<T>::value && std::is_integral<T>::value, Number> print_number(T n) {
+	return n < 0 ? Number(0 - static_cast<std::uint64_t>(n), true) : Number(n);
+}
 
 class Hexadecimal {
-	unsigned int n;
+	std::uint64_t n;
 	unsigned int digits;
 	static constexpr char get_hex(unsigned int c) {
 		return c < 10 ? '0' + c : 'A' + (c - 10);
 	}
 public:
-	constexpr Hexadecimal(unsigned int n, unsigned int digits = 1): n(n), digits(digits) {}
+	constexpr Hexadecimal(std::uint64_t n, unsigned int digits = 1): n(n), digits(digits) {}
 	void print(Context& context) const {
-		if (n >= 16 || digits > 1) {
-			Hexadecimal(n / 16, digits > 1 ? digits - 1 : digits).print(context);
+		char buffer[16];
+		char* end = buffer + sizeof(buffer);
+		char* p = end;
+		std::uint64_t m = n;
+		do {
+			--p;
+			*p = get_hex(m % 16);
+			m /= 16;
+		} while (m > 0);
+		if (digits > static_cast<std::size_t>(end - p)) {
+			context.print('0', digits - (end - p));
 		}
-		context.print(get_hex(n % 16));
+		context.print(StringView(p, end - p));
+	}
+	unsigned int get_width() const {
+		return std::max((64 - count_leading_zeros(n | 1) + 3) / 4, digits);
 	}
 };
-constexpr Hexadecimal print_hexadecimal(unsigned int n, unsigned int digits = 1) {
+constexpr Hexadecimal print_hexadecimal(std::uint64_t n, unsigned int digits = 1) {
 	return Hexadecimal(n, digits);
 }
 template <class T> constexpr Hexadecimal print_pointer(const T* ptr) {
-	return Hexadecimal(reinterpret_cast<std::size_t>(ptr));
+	return Hexadecimal(reinterpret_cast<std::uintptr_t>(ptr));
 }
 
 class Octal {
-	unsigned int n;
+	std::uint64_t n;
 	unsigned int digits;
 public:
-	constexpr Octal(unsigned int n, unsigned int digits = 1): n(n), digits(digits) {}
+	constexpr Octal(std::uint64_t n, unsigned int digits = 1): n(n), digits(digits) {}
 	void print(Context& context) const {
-		if (n >= 8 || digits > 1) {
-			Octal(n / 8, digits > 1 ? digits - 1 : digits).print(context);
+		char buffer[22];
+		char* end = buffer + sizeof(buffer);
+		char* p = end;
+		std::uint64_t m = n;
+		do {
+			--p;
+			*p = static_cast<char>('0' + m % 8);
+			m /= 8;
+		} while (m > 0);
+		if (digits > static_cast<std::size_t>(end - p)) {
+			context.print('0', digits - (end - p));
 		}
-		context.print(static_cast<char>('0' + n % 8));
+		context.print(StringView(p, end - p));
+	}
+	unsigned int get_width() const {
+		return std::max((64 - count_leading_zeros(n | 1) + 2) / 3, digits);
 	}
 };
-constexpr Octal print_octal(unsigned int n, unsigned int digits = 1) {
+constexpr Octal print_octal(std::uint64_t n, unsigned int digits = 1) {
 	return Octal(n, digits);
 }
 
@@ -231,6 +459,9 @@ public:
 		constexpr const char* CSI = "\x1B[";
 		print_impl(print_tuple(CSI, print_number(enable), 'm', p, CSI, print_number(disable), 'm'), context);
 	}
+	template <class Q = P> auto get_width() const -> decltype(get_width_impl(std::declval<const Q&>())) {
+		return 6 + print_number(enable).get_width() + get_width_impl(p) + print_number(disable).get_width();
+	}
 };
 
 class SGRFunctor {
@@ -251,15 +482,25 @@ constexpr auto blue = SGRFunctor(34, 39);
 constexpr auto magenta = SGRFunctor(35, 39);
 constexpr auto cyan = SGRFunctor(36, 39);
 
+template <class P> void print_repeated(const P& p, unsigned int count, Context& context) {
+	for (unsigned int i = 0; i < count; ++i) {
+		print_impl(p, context);
+	}
+}
+inline void print_repeated(char c, unsigned int count, Context& context) {
+	context.print(c, count);
+}
+
 template <class P> class Repeat {
 	P p;
 	unsigned int count;
 public:
 	constexpr Repeat(P p, unsigned int count): p(p), count(count) {}
 	void print(Context& context) const {
-		for (unsigned int i = 0; i < count; ++i) {
-			print_impl(p, context);
-		}
+		print_repeated(p, count, context);
+	}
+	template <class Q = P> auto get_width() const -> decltype(get_width_impl(std::declval<const Q&>())) {
+		return count * get_width_impl(p);
 	}
 };
 template <class P> constexpr Repeat<P> repeat(P p, unsigned int count) {
@@ -279,6 +520,9 @@ public:
 			context.print('s');
 		}
 	}
+	std::size_t get_width() const {
+		return print_number(count).get_width() + 1 + std::strlen(word) + (count != 1);
+	}
 };
 constexpr Plural print_plural(const char* word, unsigned int count) {
 	return Plural(word, count);
@@ -293,97 +537,91 @@ struct DiagnosticType {
 		static constexpr const char* severity = "warning";
 		static constexpr auto& color = yellow;
 	};
+	struct Note {
+		static constexpr const char* severity = "note";
+		static constexpr auto& color = cyan;
+	};
 };
 
 template <class Type, class P> void print_diagnostic(Context& context, const P& p) {
-	print_impl(bold(Type::color(format("%: ", Type::severity))), context);
+	print_impl(bold(Type::color(format(FORMAT_STRING("%: "), Type::severity))), context);
 	print_impl(p, context);
 	context.print('\n');
 }
 template <class Type, class P> void print_diagnostic(Context& context, const StringView& path, const P& p) {
 	print_diagnostic<Type>(context, p);
 	if (path) {
-		print_impl(ln(format("--> %", path)), context);
+		print_impl(ln(format(FORMAT_STRING("--> %"), path)), context);
 	}
 }
-template <class Type, class P> void print_diagnostic(Context& context, const StringView& path, const StringView& source, SourceLocation location, const P& p) {
-	location.begin = std::min(location.begin, source.size());
-	location.end = std::min(std::max(location.end, location.begin + 1), source.size() + 1);
-	unsigned int line_number = 1;
-	std::size_t line_start = 0;
+// prints a line of the source with the part that belongs to the location underlined
+template <class Type> void print_diagnostic_line(Context& context, const StringView& source, const SourceLocation& location, std::size_t line_start, unsigned int line_number, unsigned int line_number_width) {
+	constexpr unsigned int TAB_WIDTH = 4;
+	const unsigned int width_diff = line_number_width - print_number(line_number).get_width();
+
+	print_impl(format(FORMAT_STRING(" % | "), print_tuple(repeat(' ', width_diff), print_number(line_number))), context);
+	unsigned int spaces = 0;
+	unsigned int carets = 0;
+	unsigned int column = 0;
 	std::size_t i;
-	for (i = 0; i < location.begin; ++i) {
-		if (source[i] == '\n') {
-			++line_number;
-			line_start = i + 1;
+	for (i = line_start; i < source.size() && source[i] != '\n'; ++i) {
+		unsigned int char_width;
+		if (source[i] == '\t') {
+			char_width = TAB_WIDTH - column % TAB_WIDTH;
+			print_impl(repeat(' ', char_width), context);
 		}
-	}
-	const unsigned int first_line_number = line_number;
-	for (; i + 1 < location.end; ++i) {
-		if (source[i] == '\n') {
-			++line_number;
+		else {
+			char_width = 1;
+			context.print(source[i]);
+		}
+		if (i < location.end) {
+			if (i < location.begin) {
+				spaces += char_width;
+			}
+			else {
+				carets += char_width;
+			}
 		}
+		column += char_width;
 	}
-	const unsigned int last_line_number = line_number;
+	if (i == location.begin || i + 1 == location.end) {
+		++carets;
+	}
+	context.print('\n');
+
+	print_impl(format(FORMAT_STRING(" % | "), repeat(' ', line_number_width)), context);
+	print_impl(print_tuple(repeat(' ', spaces), bold(Type::color(repeat('^', carets)))), context);
+	context.print('\n');
+}
+// the line index makes the cost of a diagnostic independent of its position in the source
+template <class Type, class P> void print_diagnostic(Context& context, const StringView& path, const StringView& source, const LineIndex& line_index, SourceLocation location, const P& p) {
+	location.begin = std::min(location.begin, source.size());
+	location.end = std::min(std::max(location.end, location.begin + 1), source.size() + 1);
+	const unsigned int first_line_number = line_index.get_line(location.begin);
+	const unsigned int last_line_number = line_index.get_line(location.end - 1);
 	const unsigned int line_number_width = print_number(last_line_number).get_width();
 
 	print_diagnostic<Type>(context, p);
 
 	if (path) {
-		print_impl(ln(format(" %--> %", repeat(' ', line_number_width), path)), context);
+		print_impl(ln(format(FORMAT_STRING(" %--> %"), repeat(' ', line_number_width), path)), context);
 	}
 
-	print_impl(ln(format(" % |", repeat(' ', line_number_width))), context);
-
-	for (line_number = first_line_number; line_number <= last_line_number; ++line_number) {
-		if (line_number == first_line_number || line_number == last_line_number) {
-
-			constexpr unsigned int TAB_WIDTH = 4;
-			const unsigned int width_diff = line_number_width - print_number(line_number).get_width();
-
-			print_impl(format(" % | ", print_tuple(repeat(' ', width_diff), print_number(line_number))), context);
-			unsigned int spaces = 0;
-			unsigned int carets = 0;
-			unsigned int column = 0;
-			for (i = line_start; i < source.size() && source[i] != '\n'; ++i) {
-				unsigned int char_width;
-				if (source[i] == '\t') {
-					char_width = TAB_WIDTH - column % TAB_WIDTH;
-					print_impl(repeat(' ', char_width), context);
-				}
-				else {
-					char_width = 1;
-					context.print(source[i]);
-				}
-				if (i < location.end) {
-					if (i < location.begin) {
-						spaces += char_width;
-					}
-					else {
-						carets += char_width;
-					}
-				}
-				column += char_width;
-			}
-			if (i == location.begin || i + 1 == location.end) {
-				++carets;
-			}
-			context.print('\n');
-
-			print_impl(format(" % | ", repeat(' ', line_number_width)), context);
-			print_impl(print_tuple(repeat(' ', spaces), bold(Type::color(repeat('^', carets)))), context);
-			context.print('\n');
+	print_impl(ln(format(FORMAT_STRING(" % |"), repeat(' ', line_number_width))), context);
 
+	print_diagnostic_line<Type>(context, source, location, line_index.get_line_start(first_line_number), first_line_number, line_number_width);
+	if (last_line_number > first_line_number) {
+		if (last_line_number > first_line_number + 1) {
+			print_impl(ln(format(FORMAT_STRING(" %..."), repeat(' ', line_number_width))), context);
 		}
-		else {
-			if (line_number == first_line_number + 1) {
-				print_impl(ln(format(" %...", repeat(' ', line_number_width))), context);
-			}
-			for (i = line_start; i < source.size() && source[i] != '\n'; ++i) {}
-		}
-		line_start = i + 1;
+		print_diagnostic_line<Type>(context, source, location, line_index.get_line_start(last_line_number), last_line_number, line_number_width);
 	}
 }
+template <class Type, class P> void print_diagnostic(Context& context, const StringView& path, const StringView& source, const SourceLocation& location, const P& p) {
+	// only the lines up to the location are indexed
+	const LineIndex line_index(source.substr(0, std::min(std::max(location.end, location.begin + 1), source.size())));
+	print_diagnostic<Type>(context, path, source, line_index, location, p);
+}
 template <class... A> void print_error(A&&... a) {
 	Context context(StandardError::get());
 	print_diagnostic<DiagnosticType::Error>(context, std::forward<A>(a)...);
@@ -413,13 +651,55 @@ template <class P> void println(BufferedOutput& output, P&& p) {
 template <class P> void println(P&& p) {
 	println(StandardOutput::get(), std::forward<P>(p));
 }
-template <class P> std::string print_to_string(P&& p) {
+template <class P> std::string print_to_string_(const P& p, std::true_type) {
+	// the string is allocated once with the exact size and written directly
+	std::string s(printer::get_width_impl(p), '\0');
+	CountingOutput overflow;
+	BufferedOutput output(overflow, &s[0], s.size());
+	print(output, p);
+	return s;
+}
+template <class P> std::string print_to_string_(const P& p, std::false_type) {
 	std::string s;
 	StringOutput output(s);
 	BufferedOutput buffered(output);
-	print(buffered, std::forward<P>(p));
+	print(buffered, p);
 	return s;
 }
+template <class P> std::string print_to_string(P&& p) {
+	return print_to_string_(p, printer::has_width<typename std::decay<P>::type>());
+}
+// prints into memory of the caller without allocating and returns the number of characters that p prints, which is larger than size if the output was truncated
+template <class P> std::size_t print_to_buffer(char* buffer, std::size_t size, P&& p) {
+	CountingOutput overflow;
+	BufferedOutput output(overflow, buffer, size);
+	print(output, std::forward<P>(p));
+	return output.get_size() + overflow.get_count();
+}
+
+// the sources of diagnostics, every file is mapped and indexed only once no matter how many diagnostics refer to it
+class SourceCache {
+public:
+	class Source {
+	public:
+		MemoryMappedFile file;
+		LineIndex line_index;
+		Source(const char* path): file(path), line_index(StringView(file.data(), file.size())) {}
+		StringView get_source() const {
+			return StringView(file.data(), file.size());
+		}
+	};
+private:
+	std::map<Path, std::unique_ptr<Source>> sources;
+public:
+	const Source& get(const Path& path) {
+		std::unique_ptr<Source>& source = sources[path];
+		if (!source) {
+			source.reset(new Source(path));
+		}
+		return *source;
+	}
+};
 
 template <class Type> class Diagnostic {
 	Path path;
@@ -439,27 +719,387 @@ public:
 		}
 		context.print('\n');
 	}
+	// prints the diagnostic with a source that has already been read and indexed
+	void print(printer::Context& context, const StringView& source, const LineIndex& line_index) const {
+		if (location) {
+			printer::print_diagnostic<Type>(context, path, source, line_index, location, StringView(message));
+		}
+		else {
+			printer::print_diagnostic<Type>(context, path, StringView(message));
+		}
+		context.print('\n');
+	}
+	void print(printer::Context& context, SourceCache& sources) const {
+		if (path && location) {
+			const SourceCache::Source& source = sources.get(path);
+			print(context, source.get_source(), source.line_index);
+		}
+		else {
+			print(context);
+		}
+	}
+	const Path& get_path() const {
+		return path;
+	}
+	const SourceLocation& get_location() const {
+		return location;
+	}
+};
+
+// the message of a diagnostic that is only formatted when the diagnostic is printed, the arguments replace the placeholders like in printer::format
+// the code names the kind of diagnostic, see Diagnostics::set_limit; Diagnostics copies both strings, so the message can be a temporary
+class DiagnosticMessage {
+public:
+	const char* code;
+	const char* format;
+	constexpr DiagnosticMessage(const char* code, const char* format): code(code), format(format) {}
+};
+
+// prints a format string with arguments that have been packed one after the other, each argument is a tag followed by its value
+class PackedFormat {
+	const char* s;
+	const char* arguments;
+	const char* arguments_end;
+public:
+	enum: char {
+		STRING,
+		SIGNED,
+		UNSIGNED
+	};
+	static void pack(std::vector<char>& arena, const StringView& s) {
+		const std::uint32_t size = s.size();
+		arena.push_back(STRING);
+		arena.insert(arena.end(), reinterpret_cast<const char*>(&size), reinterpret_cast<const char*>(&size) + sizeof(size));
+		arena.insert(arena.end(), s.begin(), s.end());
+	}
+	static void pack(std::vector<char>& arena, const char* s) {
+		pack(arena, StringView(s));
+	}
+	static void pack(std::vector<char>& arena, const std::string& s) {
+		pack(arena, StringView(s));
+	}
+	static void pack(std::vector<char>& arena, char c) {
+		pack(arena, StringView(&c, 1));
+	}
+	template <class T> static enable_if_t<std::is_integral<T>::value && std::is_signed<T>::value> pack(std::vector<char>& arena, T t) {
+		const std::int64_t n = t;
+		arena.push_back(SIGNED);
+		arena.insert(arena.end(), reinterpret_cast<const char*>(&n), reinterpret_cast<const char*>(&n) + sizeof(n));
+	}
+	template <class T> static enable_if_t<std::is_unsigned<T>::value> pack(std::vector<char>& arena, T t) {
+		const std::uint64_t n = t;
+		arena.push_back(UNSIGNED);
+		arena.insert(arena.end(), reinterpret_cast<const char*>(&n), reinterpret_cast<const char*>(&n) + sizeof(n));
+	}
+	constexpr PackedFormat(const char* s, const char* arguments, const char* arguments_end): s(s), arguments(arguments), arguments_end(arguments_end) {}
+	void print(printer::Context& context) const {
+		const char* s = this->s;
+		const char* argument = arguments;
+		while (*s) {
+			const char* percent = std::strchr(s, '%');
+			if (percent == nullptr) {
+				printer::print_impl(s, context);
+				return;
+			}
+			if (percent[1] == '%' || argument == arguments_end) {
+				context.print(StringView(s, percent - s + 1));
+				s = percent + (percent[1] == '%' ? 2 : 1);
+				continue;
+			}
+			context.print(StringView(s, percent - s));
+			const char tag = *argument;
+			++argument;
+			if (tag == STRING) {
+				std::uint32_t size;
+				std::memcpy(&size, argument, sizeof(size));
+				argument += sizeof(size);
+				context.print(StringView(argument, size));
+				argument += size;
+			}
+			else if (tag == SIGNED) {
+				std::int64_t n;
+				std::memcpy(&n, argument, sizeof(n));
+				argument += sizeof(n);
+				printer::print_impl(printer::print_number(n), context);
+			}
+			else {
+				std::uint64_t n;
+				std::memcpy(&n, argument, sizeof(n));
+				argument += sizeof(n);
+				printer::print_impl(printer::print_number(n), context);
+			}
+			s = percent + 1;
+		}
+	}
 };
 
+// diagnostics are stored compactly and only formatted when they are printed
+// identical diagnostics are stored only once and the number of diagnostics of each code can be limited
 class Diagnostics {
-	std::vector<Diagnostic<printer::DiagnosticType::Error>> errors;
-	std::vector<Diagnostic<printer::DiagnosticType::Warning>> warnings;
+	static constexpr std::uint32_t NONE = -1;
+	class Record {
+	public:
+		std::uint32_t file;
+		// offsets from 4 GiB on are stored as an invalid location
+		std::uint32_t begin;
+		std::uint32_t end;
+		std::uint32_t message;
+		// the position of the packed arguments in the arena
+		std::uint32_t arguments;
+		std::uint32_t arguments_size;
+	};
+	// an open addressing hash table of indices into a vector; the hashes are kept in the table so that the vector is only accessed on a likely match
+	class Index {
+		class Slot {
+		public:
+			std::uint64_t hash;
+			std::uint32_t index;
+			Slot(): hash(0), index(NONE) {}
+		};
+		std::vector<Slot> slots;
+		std::size_t size = 0;
+		void insert_slot(std::uint64_t hash, std::uint32_t index) {
+			const std::size_t mask = slots.size() - 1;
+			std::size_t i = hash & mask;
+			while (slots[i].index != NONE) {
+				i = (i + 1) & mask;
+			}
+			slots[i].hash = hash;
+			slots[i].index = index;
+		}
+	public:
+		// the index for which equal returns true, NONE if there is none
+		template <class F> std::uint32_t find(std::uint64_t hash, F equal) const {
+			if (slots.empty()) {
+				return NONE;
+			}
+			const std::size_t mask = slots.size() - 1;
+			for (std::size_t i = hash & mask; slots[i].index != NONE; i = (i + 1) & mask) {
+				if (slots[i].hash == hash && equal(slots[i].index)) {
+					return slots[i].index;
+				}
+			}
+			return NONE;
+		}
+		void insert(std::uint64_t hash, std::uint32_t index) {
+			// at most three quarters of the slots are used
+			if ((size + 1) * 4 > slots.size() * 3) {
+				std::vector<Slot> old_slots(slots.empty() ? 16 : slots.size() * 2);
+				std::swap(slots, old_slots);
+				for (const Slot& slot: old_slots) {
+					if (slot.index != NONE) {
+						insert_slot(slot.hash, slot.index);
+					}
+				}
+			}
+			insert_slot(hash, index);
+			++size;
+		}
+	};
+	class RecordList {
+	public:
+		std::vector<Record> records;
+		// the records by their hash, to find duplicates
+		Index index;
+		// including the diagnostics that were not stored because of a limit
+		std::size_t count = 0;
+	};
+	RecordList errors;
+	RecordList warnings;
+	std::vector<char> arena;
+	std::vector<Path> files;
+	std::map<Path, std::uint32_t> file_ids;
+	// the kinds of diagnostics by their code
+	class Kind {
+	public:
+		std::string code;
+		std::size_t count;
+		std::size_t limit;
+		std::size_t suppressed;
+		Kind(const StringView& code): code(code.to_string()), count(0), limit(-1), suppressed(0) {}
+	};
+	std::vector<Kind> kinds;
+	Index kind_index;
+	class Message {
+	public:
+		std::string format;
+		std::uint32_t kind;
+		Message(const StringView& format, std::uint32_t kind): format(format.to_string()), kind(kind) {}
+	};
+	std::vector<Message> messages;
+	Index message_index;
+	// consecutive diagnostics usually have the same message
+	std::uint32_t last_message = NONE;
+	// a diagnostic that was added with a printer is printed eagerly and passed as the only argument of this message
+	static const DiagnosticMessage& get_printed_message() {
+		static constexpr DiagnosticMessage message(nullptr, "%");
+		return message;
+	}
+	static std::uint32_t get_offset(std::size_t offset) {
+		return offset < NONE ? offset : NONE;
+	}
+	std::uint32_t get_file_id(const char* path) {
+		if (path == nullptr || *path == '\0') {
+			return NONE;
+		}
+		// consecutive diagnostics usually belong to the same file
+		if (!files.empty()) {
+			const StringView last = files.back();
+			if (last == StringView(path)) {
+				return files.size() - 1;
+			}
+		}
+		auto result = file_ids.emplace(Path(path), files.size());
+		if (result.second) {
+			files.emplace_back(path);
+		}
+		return result.first->second;
+	}
+	// FNV-1a
+	static std::uint64_t get_hash(const char* data, std::size_t size, std::uint64_t hash = 0xCBF29CE484222325) {
+		for (std::size_t i = 0; i < size; ++i) {
+			hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001B3;
+		}
+		return hash;
+	}
+	std::uint64_t get_hash(const Record& record) const {
+		const std::uint32_t fields[] = {record.file, record.begin, record.end, record.message};
+		return get_hash(arena.data() + record.arguments, record.arguments_size, get_hash(reinterpret_cast<const char*>(fields), sizeof(fields)));
+	}
+	std::uint32_t get_kind_id(const char* code) {
+		const StringView s(code ? code : "");
+		const std::uint64_t hash = get_hash(s.data(), s.size());
+		std::uint32_t id = kind_index.find(hash, [&](std::uint32_t i) {
+			return StringView(kinds[i].code) == s;
+		});
+		if (id == NONE) {
+			id = kinds.size();
+			kinds.emplace_back(s);
+			kind_index.insert(hash, id);
+		}
+		return id;
+	}
+	// messages are identified by their strings and not by their address
+	std::uint32_t get_message_id(const DiagnosticMessage& message) {
+		if (last_message != NONE && std::strcmp(messages[last_message].format.c_str(), message.format) == 0 && std::strcmp(kinds[messages[last_message].kind].code.c_str(), message.code ? message.code : "") == 0) {
+			return last_message;
+		}
+		const std::uint32_t kind = get_kind_id(message.code);
+		const StringView format(message.format);
+		const std::uint64_t hash = get_hash(format.data(), format.size(), get_hash(reinterpret_cast<const char*>(&kind), sizeof(kind)));
+		std::uint32_t id = message_index.find(hash, [&](std::uint32_t i) {
+			return messages[i].kind == kind && StringView(messages[i].format) == format;
+		});
+		if (id == NONE) {
+			id = messages.size();
+			messages.emplace_back(format, kind);
+			message_index.insert(hash, id);
+		}
+		last_message = id;
+		return id;
+	}
+	bool is_equal(const Record& lhs, const Record& rhs) const {
+		return lhs.file == rhs.file && lhs.begin == rhs.begin && lhs.end == rhs.end && lhs.message == rhs.message && lhs.arguments_size == rhs.arguments_size && std::memcmp(arena.data() + lhs.arguments, arena.data() + rhs.arguments, lhs.arguments_size) == 0;
+	}
+	static void pack_arguments(std::vector<char>& arena) {}
+	template <class A0, class... A> static void pack_arguments(std::vector<char>& arena, const A0& a0, const A&... a) {
+		PackedFormat::pack(arena, a0);
+		pack_arguments(arena, a...);
+	}
+	template <class... A> void add(RecordList& list, const DiagnosticMessage& message, const char* path, const SourceLocation& location, const A&... arguments) {
+		Record record;
+		record.file = get_file_id(path);
+		record.begin = location ? get_offset(location.begin) : NONE;
+		record.end = location ? get_offset(location.end) : NONE;
+		record.message = get_message_id(message);
+		record.arguments = arena.size();
+		pack_arguments(arena, arguments...);
+		record.arguments_size = arena.size() - record.arguments;
+		const std::uint64_t hash = get_hash(record);
+		const std::uint32_t duplicate = list.index.find(hash, [&](std::uint32_t i) {
+			return is_equal(list.records[i], record);
+		});
+		if (duplicate != NONE) {
+			arena.resize(record.arguments);
+			return;
+		}
+		++list.count;
+		Kind& kind = kinds[messages[record.message].kind];
+		if (kind.count >= kind.limit) {
+			++kind.suppressed;
+			arena.resize(record.arguments);
+			return;
+		}
+		++kind.count;
+		list.index.insert(hash, list.records.size());
+		list.records.push_back(record);
+	}
+	template <class P> void add(RecordList& list, const char* path, const SourceLocation& location, const P& p) {
+		add(list, get_printed_message(), path, location, print_to_string(p));
+	}
+	template <class P> void add(RecordList& list, const char* path, const P& p) {
+		add(list, get_printed_message(), path, SourceLocation(), print_to_string(p));
+	}
+	template <class P> void add(RecordList& list, const P& p) {
+		add(list, get_printed_message(), nullptr, SourceLocation(), print_to_string(p));
+	}
+	// prints the diagnostics grouped by file and ordered by their location within the file
+	template <class Type> void print(printer::Context& context, const RecordList& list, SourceCache& sources) const {
+		std::vector<const Record*> sorted;
+		sorted.reserve(list.records.size());
+		for (const Record& record: list.records) {
+			sorted.push_back(&record);
+		}
+		std::stable_sort(sorted.begin(), sorted.end(), [&](const Record* lhs, const Record* rhs) {
+			if (lhs->file != rhs->file) {
+				if (lhs->file == NONE || rhs->file == NONE) {
+					return lhs->file == NONE;
+				}
+				return files[lhs->file] < files[rhs->file];
+			}
+			return lhs->begin < rhs->begin;
+		});
+		for (const Record* record: sorted) {
+			const char* arguments = arena.data() + record->arguments;
+			const PackedFormat message(messages[record->message].format.c_str(), arguments, arguments + record->arguments_size);
+			StringView path;
+			if (record->file != NONE) {
+				path = files[record->file];
+			}
+			if (path && record->begin != NONE && record->end != NONE) {
+				const SourceCache::Source& source = sources.get(files[record->file]);
+				printer::print_diagnostic<Type>(context, path, source.get_source(), source.line_index, SourceLocation(record->begin, record->end), message);
+			}
+			else {
+				printer::print_diagnostic<Type>(context, path, message);
+			}
+			context.print('\n');
+		}
+	}
 public:
 	bool has_error() const {
-		return !errors.empty();
+		return errors.count > 0;
 	}
 	template <class... A> void add_error(A&&... a) {
-		errors.emplace_back(std::forward<A>(a)...);
+		add(errors, std::forward<A>(a)...);
 	}
 	template <class... A> void add_warning(A&&... a) {
-		warnings.emplace_back(std::forward<A>(a)...);
+		add(warnings, std::forward<A>(a)...);
+	}
+	// at most limit diagnostics with the code of the given message are stored, the others are only counted
+	// diagnostics that were already stored are kept even if there are more of them than the new limit
+	void set_limit(const DiagnosticMessage& message, std::size_t limit) {
+		kinds[get_kind_id(message.code)].limit = limit;
 	}
 	void print(printer::Context& context) const {
-		for (const Diagnostic<printer::DiagnosticType::Warning>& warning: warnings) {
-			warning.print(context);
-		}
-		for (const Diagnostic<printer::DiagnosticType::Error>& error: errors) {
-			error.print(context);
+		SourceCache sources;
+		print<printer::DiagnosticType::Warning>(context, warnings, sources);
+		print<printer::DiagnosticType::Error>(context, errors, sources);
+		for (const Kind& kind: kinds) {
+			if (kind.suppressed > 0) {
+				printer::print_diagnostic<printer::DiagnosticType::Note>(context, printer::format(FORMAT_STRING("% of kind \"%\" not shown"), printer::print_plural("diagnostic", kind.suppressed), StringView(kind.code)));
+				context.print('\n');
+			}
 		}
 	}
 	void print() const {
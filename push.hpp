@@ -0,0 +1,104 @@
+#pragma once
+
+#include "parser.hpp"
+#include "os.hpp"
+#include <functional>
+#include <memory>
+
+namespace parser {
+
+// parses input that arrives in parts, for example from a socket, without a thread per input
+// the parser runs on its own stack and is suspended whenever it reaches the end of the input that has arrived so far
+// the input is kept in a buffer of fixed capacity so that the save points of the suspended parser remain valid
+class PushParser: PushInput {
+	std::unique_ptr<char[]> buffer;
+	std::size_t capacity;
+	std::size_t size;
+	// the size of the input the context knows about
+	std::size_t available;
+	Context context;
+	std::function<Result(Context&)> function;
+	Coroutine coroutine;
+	Result result;
+	// no more input will arrive
+	bool closed;
+	static void run(void* data) {
+		PushParser* parser = static_cast<PushParser*>(data);
+		parser->result = parser->function(parser->context);
+	}
+	const char* wait_for_input() override {
+		if (available == size && !closed) {
+			coroutine.suspend();
+		}
+		if (available == size) {
+			return nullptr;
+		}
+		available = size;
+		return buffer.get() + available;
+	}
+	Result resume() {
+		if (!coroutine.resume()) {
+			context.set_error(StringView("could not allocate a stack"));
+			result = ERROR;
+			closed = true;
+		}
+		return get_result();
+	}
+public:
+	template <class P, class C = Ignore> PushParser(std::size_t capacity, P p, const C& callback = C(), std::size_t stack_size = 1024 * 1024): buffer(new char[capacity]), capacity(capacity), size(0), available(0), context(StringView(buffer.get(), 0)), function([p, callback](Context& context) { return ::parse(context, p, callback); }), coroutine(stack_size, &run, this), result(INCOMPLETE), closed(false) {
+		context.set_push_input(this);
+	}
+	PushParser(const PushParser&) = delete;
+	~PushParser() {
+		if (coroutine.is_started() && !coroutine.is_done()) {
+			// let the suspended parser finish so that its stack is unwound
+			closed = true;
+			coroutine.resume();
+		}
+	}
+	PushParser& operator =(const PushParser&) = delete;
+	// the context of the parse, for example to set its limits before the first call to feed()
+	Context& get_context() {
+		return context;
+	}
+	// INCOMPLETE while the parser waits for more input, otherwise the result of the parse
+	Result get_result() const {
+		return coroutine.is_done() || closed ? result : INCOMPLETE;
+	}
+	// appends data to the input and parses as far as possible
+	Result feed(const StringView& data) {
+		if (coroutine.is_done() || closed) {
+			return result;
+		}
+		if (data.size() > capacity - size) {
+			// the parse ends as if the input ended here
+			closed = true;
+			if (coroutine.is_started()) {
+				coroutine.resume();
+			}
+			context.set_error(StringView("input exceeds the capacity of the buffer"));
+			result = ERROR;
+			return result;
+		}
+		if (data.empty()) {
+			return INCOMPLETE;
+		}
+		std::memcpy(buffer.get() + size, data.data(), data.size());
+		size += data.size();
+		return resume();
+	}
+	// signals the end of the input, the parse ends with a result other than INCOMPLETE
+	Result finish() {
+		if (coroutine.is_done() || closed) {
+			return result;
+		}
+		closed = true;
+		return resume();
+	}
+	// the input that has arrived so far, the input after the end of a successful parse can be fed to the next parser
+	StringView get_input() const {
+		return StringView(buffer.get(), size);
+	}
+};
+
+}
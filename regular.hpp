@@ -0,0 +1,339 @@
+#pragma once
+
+#include "parser.hpp"
+#include "analysis.hpp"
+
+namespace parser {
+
+// parsers that can be compiled to a DFA by regular()
+template <class P> struct is_regular: std::false_type {};
+template <> struct is_regular<CharClass<Char>>: std::true_type {};
+template <> struct is_regular<CharClass<AnyChar>>: std::true_type {};
+template <> struct is_regular<CharClass<CharRange>>: std::true_type {};
+template <> struct is_regular<CharClass<OneOf>>: std::true_type {};
+template <> struct is_regular<char>: std::true_type {};
+template <> struct is_regular<StringView>: std::true_type {};
+template <> struct is_regular<const char*>: std::true_type {};
+template <> struct is_regular<Sequence<>>: std::true_type {};
+template <class P0, class... P> struct is_regular<Sequence<P0, P...>>: std::integral_constant<bool, is_regular<P0>::value && is_regular<Sequence<P...>>::value> {};
+template <> struct is_regular<Choice<>>: std::true_type {};
+template <class P0, class... P> struct is_regular<Choice<P0, P...>>: std::integral_constant<bool, is_regular<P0>::value && is_regular<Choice<P...>>::value> {};
+template <class P> struct is_regular<Repetition<P>>: is_regular<P> {};
+template <class P> struct is_regular<Ignore_<P>>: is_regular<P> {};
+
+// the position automaton (Glushkov automaton) of a regular parser; every character of the parser is a position
+class PositionAutomaton {
+public:
+	static constexpr std::size_t MAX_POSITIONS = 63;
+	CharSet chars[MAX_POSITIONS];
+	// the positions that can follow each position
+	std::uint64_t follow[MAX_POSITIONS];
+	std::size_t size;
+	// false if the parser has too many positions or if a DFA would not behave like the parser
+	bool valid;
+	constexpr PositionAutomaton(): chars(), follow(), size(0), valid(true) {}
+	constexpr std::uint64_t add(const CharSet& c) {
+		if (size == MAX_POSITIONS) {
+			valid = false;
+			return 0;
+		}
+		chars[size] = c;
+		follow[size] = 0;
+		++size;
+		return std::uint64_t(1) << (size - 1);
+	}
+	constexpr void add_follow(std::uint64_t from, std::uint64_t to) {
+		for (std::size_t i = 0; i < size; ++i) {
+			if (from >> i & 1) {
+				follow[i] |= to;
+			}
+		}
+	}
+	// whether the next character always determines the next position
+	constexpr bool is_deterministic(std::uint64_t positions) const {
+		for (std::size_t i = 0; i < size; ++i) {
+			for (std::size_t j = i + 1; j < size; ++j) {
+				if ((positions >> i & 1) && (positions >> j & 1) && chars[i].intersects(chars[j])) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+};
+
+class PositionInfo {
+public:
+	std::uint64_t first;
+	std::uint64_t last;
+	bool nullable;
+	constexpr PositionInfo(std::uint64_t first, std::uint64_t last, bool nullable): first(first), last(last), nullable(nullable) {}
+	static constexpr PositionInfo empty() {
+		return PositionInfo(0, 0, true);
+	}
+};
+
+constexpr PositionInfo add_positions(PositionAutomaton& a, const CharSet& c) {
+	const std::uint64_t position = a.add(c);
+	return PositionInfo(position, position, false);
+}
+constexpr PositionInfo add_positions(PositionAutomaton& a, const PositionInfo& lhs, const PositionInfo& rhs) {
+	// sequence
+	a.add_follow(lhs.last, rhs.first);
+	return PositionInfo(lhs.nullable ? lhs.first | rhs.first : lhs.first, rhs.nullable ? lhs.last | rhs.last : rhs.last, lhs.nullable && rhs.nullable);
+}
+
+template <class F> constexpr PositionInfo get_positions(PositionAutomaton& a, const CharClass<F>& p) {
+	return add_positions(a, get_char_set(p.f));
+}
+constexpr PositionInfo get_positions(PositionAutomaton& a, char c) {
+	return add_positions(a, CharSet(c));
+}
+constexpr PositionInfo get_positions(PositionAutomaton& a, const StringView& s) {
+	PositionInfo info = PositionInfo::empty();
+	for (char c: s) {
+		info = add_positions(a, info, add_positions(a, CharSet(c)));
+	}
+	return info;
+}
+constexpr PositionInfo get_positions(PositionAutomaton& a, const char* s) {
+	return get_positions(a, StringView(s));
+}
+constexpr PositionInfo get_positions(PositionAutomaton& a, const Sequence<>& p) {
+	return PositionInfo::empty();
+}
+template <class P0, class... P> constexpr PositionInfo get_positions(PositionAutomaton& a, const Sequence<P0, P...>& p) {
+	const PositionInfo head = get_positions(a, p.head);
+	return add_positions(a, head, get_positions(a, p.tail));
+}
+constexpr PositionInfo get_positions(PositionAutomaton& a, const Choice<>& p) {
+	return PositionInfo(0, 0, false);
+}
+template <class P0, class... P> constexpr PositionInfo get_positions(PositionAutomaton& a, const Choice<P0, P...>& p) {
+	const PositionInfo head = get_positions(a, p.head);
+	const PositionInfo tail = get_positions(a, p.tail);
+	if (head.nullable && sizeof...(P) > 0) {
+		// the parser never tries the following alternatives but a DFA would
+		a.valid = false;
+	}
+	return PositionInfo(head.first | tail.first, head.last | tail.last, head.nullable || tail.nullable);
+}
+template <class P> constexpr PositionInfo get_positions(PositionAutomaton& a, const Repetition<P>& p) {
+	const PositionInfo info = get_positions(a, p.p);
+	if (info.nullable) {
+		a.valid = false;
+	}
+	a.add_follow(info.last, info.first);
+	return PositionInfo(info.first, info.last, true);
+}
+template <class P> constexpr PositionInfo get_positions(PositionAutomaton& a, const Ignore_<P>& p) {
+	return get_positions(a, p.p);
+}
+
+// a minimized DFA with a transition table over classes of equivalent characters
+class RegularDFA {
+public:
+	static constexpr std::size_t MAX_STATES = PositionAutomaton::MAX_POSITIONS + 1;
+	static constexpr std::size_t MAX_CLASSES = 32;
+	static constexpr std::uint8_t DEAD = 0xFF;
+	// false if the parser has to be parsed without the DFA
+	bool valid;
+	std::uint8_t start;
+	std::uint8_t classes[256];
+	std::uint8_t transitions[MAX_STATES][MAX_CLASSES];
+	// a bit for each accepting state
+	std::uint64_t accepting;
+	// for each state a bit for each class that leads back to the same state, so that runs of such characters are skipped in a tight loop
+	std::uint32_t self_loops[MAX_STATES];
+	// the zero byte leads to DEAD from every state, so the zero after the end of a padded input ends every match
+	bool stops_at_zero;
+	constexpr RegularDFA(): valid(false), start(0), classes(), transitions(), accepting(0), self_loops(), stops_at_zero(false) {}
+};
+
+// state 0 is the start state and state i + 1 is the state after position i
+template <class P> constexpr RegularDFA get_regular_dfa(const P& p) {
+	RegularDFA dfa;
+	PositionAutomaton a;
+	const PositionInfo root = get_positions(a, p);
+	if (!a.valid || !a.is_deterministic(root.first)) {
+		return dfa;
+	}
+	for (std::size_t i = 0; i < a.size; ++i) {
+		if (!a.is_deterministic(a.follow[i])) {
+			return dfa;
+		}
+	}
+	// characters that are contained in the same positions belong to the same class
+	std::uint64_t class_positions[RegularDFA::MAX_CLASSES] = {};
+	std::size_t class_count = 0;
+	for (unsigned int c = 0; c < 256; ++c) {
+		std::uint64_t positions = 0;
+		for (std::size_t i = 0; i < a.size; ++i) {
+			if (a.chars[i].contains(static_cast<char>(c))) {
+				positions |= std::uint64_t(1) << i;
+			}
+		}
+		std::size_t k = 0;
+		while (k < class_count && class_positions[k] != positions) {
+			++k;
+		}
+		if (k == class_count) {
+			if (class_count == RegularDFA::MAX_CLASSES) {
+				return dfa;
+			}
+			class_positions[k] = positions;
+			++class_count;
+		}
+		dfa.classes[c] = k;
+	}
+	const std::size_t state_count = a.size + 1;
+	std::uint8_t transitions[RegularDFA::MAX_STATES][RegularDFA::MAX_CLASSES] = {};
+	bool accepting[RegularDFA::MAX_STATES] = {};
+	for (std::size_t s = 0; s < state_count; ++s) {
+		const std::uint64_t candidates = s == 0 ? root.first : a.follow[s - 1];
+		for (std::size_t k = 0; k < class_count; ++k) {
+			const std::uint64_t next = candidates & class_positions[k];
+			transitions[s][k] = RegularDFA::DEAD;
+			for (std::size_t i = 0; i < a.size; ++i) {
+				if (next >> i & 1) {
+					transitions[s][k] = i + 1;
+				}
+			}
+		}
+		accepting[s] = s == 0 ? root.nullable : (root.last >> (s - 1) & 1);
+	}
+	// minimize by refining the partition into accepting and non-accepting states until it is stable
+	std::uint8_t block[RegularDFA::MAX_STATES] = {};
+	std::size_t block_count = 0;
+	while (true) {
+		std::uint8_t next_block[RegularDFA::MAX_STATES] = {};
+		std::size_t next_block_count = 0;
+		for (std::size_t s = 0; s < state_count; ++s) {
+			std::size_t t = 0;
+			for (; t < s; ++t) {
+				bool equivalent = accepting[t] == accepting[s] && block[t] == block[s];
+				for (std::size_t k = 0; equivalent && k < class_count; ++k) {
+					const std::uint8_t s_next = transitions[s][k];
+					const std::uint8_t t_next = transitions[t][k];
+					equivalent = s_next == RegularDFA::DEAD || t_next == RegularDFA::DEAD ? s_next == t_next : block[s_next] == block[t_next];
+				}
+				if (equivalent) {
+					break;
+				}
+			}
+			if (t < s) {
+				next_block[s] = next_block[t];
+			}
+			else {
+				next_block[s] = next_block_count;
+				++next_block_count;
+			}
+		}
+		for (std::size_t s = 0; s < state_count; ++s) {
+			block[s] = next_block[s];
+		}
+		if (next_block_count == block_count) {
+			break;
+		}
+		block_count = next_block_count;
+	}
+	for (std::size_t s = 0; s < state_count; ++s) {
+		for (std::size_t k = 0; k < class_count; ++k) {
+			dfa.transitions[block[s]][k] = transitions[s][k] == RegularDFA::DEAD ? RegularDFA::DEAD : block[transitions[s][k]];
+			if (dfa.transitions[block[s]][k] == block[s]) {
+				dfa.self_loops[block[s]] |= std::uint32_t(1) << k;
+			}
+		}
+		if (accepting[s]) {
+			dfa.accepting |= std::uint64_t(1) << block[s];
+		}
+	}
+	dfa.start = block[0];
+	dfa.stops_at_zero = class_positions[dfa.classes[0]] == 0;
+	dfa.valid = true;
+	return dfa;
+}
+
+// P is matched with a table-driven DFA instead of backtracking; values are not collected, use collect_string(regular(p)) to get the string
+// if the DFA would not match like P (for example choice("in", "int") or an unbounded repetition followed by the same character) P is parsed as usual
+template <class P> class Regular {
+public:
+	P p;
+	RegularDFA dfa;
+	constexpr Regular(P p): p(p), dfa(get_regular_dfa(p)) {}
+};
+
+template <class P> constexpr Regular<P> regular(P p) {
+	static_assert(is_regular<P>::value, "regular() only supports characters, character ranges, one_of(), literals, sequence(), choice() and repetition(); use collect_string(regular(p)) to get the string");
+	return Regular<P>(p);
+}
+
+template <class P> struct is_terminal<Regular<P>>: std::true_type {};
+
+template <class P, class C> Result parse_impl(const Regular<P>& p, Context& context, const C& callback) {
+	if (!p.dfa.valid) {
+		return parse_impl(p.p, context, Ignore());
+	}
+	const SavePoint save_point = context.save();
+	const char* position = save_point;
+	const char* end = context.get_rest().end();
+	const char* match = p.dfa.accepting >> p.dfa.start & 1 ? position : nullptr;
+	std::uint8_t state = p.dfa.start;
+	if (context.is_padded() && p.dfa.stops_at_zero) {
+		// no end checks are necessary
+		while (true) {
+			state = p.dfa.transitions[state][p.dfa.classes[static_cast<unsigned char>(*position)]];
+			if (state == RegularDFA::DEAD) {
+				break;
+			}
+			++position;
+			const std::uint32_t self_loop = p.dfa.self_loops[state];
+			while (self_loop >> p.dfa.classes[static_cast<unsigned char>(*position)] & 1) {
+				++position;
+			}
+			if (p.dfa.accepting >> state & 1) {
+				match = position;
+			}
+		}
+		context.restore(match ? match : save_point);
+		return match ? SUCCESS : FAILURE;
+	}
+	while (true) {
+		while (position < end) {
+			state = p.dfa.transitions[state][p.dfa.classes[static_cast<unsigned char>(*position)]];
+			if (state == RegularDFA::DEAD) {
+				break;
+			}
+			++position;
+			const std::uint32_t self_loop = p.dfa.self_loops[state];
+			while (position < end && (self_loop >> p.dfa.classes[static_cast<unsigned char>(*position)] & 1)) {
+				++position;
+			}
+			if (p.dfa.accepting >> state & 1) {
+				match = position;
+			}
+		}
+		if (state == RegularDFA::DEAD) {
+			break;
+		}
+		// the match can continue in the next segment or in input that has not arrived yet
+		context.restore(position);
+		if (!context.next_input()) {
+			break;
+		}
+		position = context.save();
+		end = context.get_rest().end();
+	}
+	if (match == nullptr) {
+		context.restore(save_point);
+		return FAILURE;
+	}
+	context.restore(match);
+	return SUCCESS;
+}
+
+template <class P, class V> constexpr GrammarInfo analyze_impl(const Regular<P>& p, V v) {
+	return analyze_impl(p.p, v);
+}
+
+}
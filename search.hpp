@@ -0,0 +1,281 @@
+#pragma once
+
+#include "parser.hpp"
+#include "analysis.hpp"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace parser {
+
+// skips the positions at which a parser with the given FIRST set cannot start a non-empty match
+class FirstSetFilter {
+	CharSet first;
+	CharFinder finder;
+	bool any;
+	bool small;
+public:
+	FirstSetFilter(const GrammarInfo& info): first(info.first), any(info.eager_error), small(false) {
+		if (!any && first.size() <= 8) {
+			small = true;
+			for (unsigned int i = 0; i < 256; ++i) {
+				if (first.contains(static_cast<char>(i))) {
+					finder.insert(static_cast<char>(i));
+				}
+			}
+		}
+	}
+	// the first position at or after position that passes the filter, end if there is none
+	const char* find(const char* position, const char* end) const {
+		if (any) {
+			return position;
+		}
+		if (small) {
+			return finder.find(position, end);
+		}
+		while (position < end && !first.contains(*position)) {
+			++position;
+		}
+		return position;
+	}
+};
+
+template <class T> class SearchMatch {
+public:
+	SourceLocation location;
+	T value;
+	SearchMatch(): value() {}
+	GetValueCallback<T> get_callback() {
+		return GetValueCallback<T>(value);
+	}
+	template <class F> void call(F& f) {
+		f(location, std::move(value));
+	}
+};
+template <> class SearchMatch<void> {
+public:
+	SourceLocation location;
+	SearchMatch() {}
+	Ignore get_callback() {
+		return Ignore();
+	}
+	template <class F> void call(F& f) {
+		f(location);
+	}
+};
+
+// finds the next non-empty match that starts before limit and leaves the context at its end
+// on ERROR the location of the match is from the position at which p was tried to the position of the error
+template <class T, class P> Result search_next(Context& context, const P& p, const FirstSetFilter& filter, SavePoint limit, SearchMatch<T>& match) {
+	while (true) {
+		const SavePoint candidate = filter.find(context.save(), limit);
+		if (candidate >= limit) {
+			return FAILURE;
+		}
+		context.restore(candidate);
+		match = SearchMatch<T>();
+		const Result result = parse_impl(p, context, match.get_callback());
+		if (result == ERROR) {
+			match.location = context.get_location(candidate);
+			return ERROR;
+		}
+		if (result == SUCCESS && context.save() != candidate) {
+			match.location = context.get_location(candidate);
+			return SUCCESS;
+		}
+		context.restore(candidate + 1);
+	}
+}
+
+template <class T> class SearchChunk {
+public:
+	std::vector<SearchMatch<T>> matches;
+	Result result;
+	std::string error;
+	// the matches of the chunk all begin before the error
+	SourceLocation error_location;
+	bool aborted;
+	bool done;
+	SearchChunk(): result(SUCCESS), aborted(false), done(false) {}
+};
+
+}
+
+// calls f(location, value) for the matches of p from the current position of the context to its end, where value is the result of p as a T
+// like grep -o the search continues after the end of a match and empty matches are not reported
+template <class T, class P, class F> parser::Result search(parser::Context& context, const P& p, F&& f) {
+	using namespace parser;
+	if (context.is_segmented()) {
+		context.set_error(StringView("search() requires contiguous input"));
+		return ERROR;
+	}
+	const FirstSetFilter filter(analyze(p));
+	const SavePoint end = context.get_rest().end();
+	SearchMatch<T> match;
+	while (true) {
+		const Result result = search_next(context, p, filter, end, match);
+		if (result == ERROR) {
+			return context.is_aborted() ? ABORTED : ERROR;
+		}
+		if (result == FAILURE) {
+			return SUCCESS;
+		}
+		match.call(f);
+	}
+}
+// calls f(location) for the matches of p
+template <class P, class F> parser::Result search(parser::Context& context, const P& p, F&& f) {
+	return search<void>(context, p, std::forward<F>(f));
+}
+template <class T, class P, class F> parser::Result search(const StringView& s, const P& p, F&& f) {
+	parser::Context context(s);
+	return search<T>(context, p, std::forward<F>(f));
+}
+template <class P, class F> parser::Result search(const StringView& s, const P& p, F&& f) {
+	return search<void>(s, p, std::forward<F>(f));
+}
+
+// the same matches as search(), found by several threads in chunks of chunk_size characters
+// f is called on the calling thread in order; the threads share the limits of the context except for the step budget, which only applies to the calling thread
+template <class T, class P, class F> parser::Result parallel_search(parser::Context& context, const P& p, F&& f, unsigned int threads = std::thread::hardware_concurrency(), std::size_t chunk_size = 16 * 1024 * 1024) {
+	using namespace parser;
+	if (context.is_segmented()) {
+		context.set_error(StringView("parallel_search() requires contiguous input"));
+		return ERROR;
+	}
+	const FirstSetFilter filter(analyze(p));
+	const StringView source = context.get_source();
+	const SavePoint begin = context.save();
+	const SavePoint end = context.get_rest().end();
+	ContextLimits limits = context.get_limits();
+	limits.max_steps = -1;
+	const std::size_t chunk_count = (end - begin + chunk_size - 1) / chunk_size;
+	std::vector<SearchChunk<T>> chunks(chunk_count);
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::atomic<std::size_t> next_chunk(0);
+	std::atomic<bool> stop(false);
+	const unsigned int thread_count = threads > 0 ? threads : 1;
+	// the workers stay at most this many chunks ahead of the calling thread, so that only the matches of these chunks are kept
+	const std::size_t window = thread_count * 2;
+	// the number of chunks whose matches have been passed to f, guarded by mutex
+	std::size_t consumed = 0;
+	auto worker = [&]() {
+		while (!stop.load(std::memory_order_relaxed)) {
+			const std::size_t i = next_chunk++;
+			if (i >= chunk_count) {
+				break;
+			}
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [&]() {
+					return i < consumed + window || stop.load(std::memory_order_relaxed);
+				});
+			}
+			if (stop.load(std::memory_order_relaxed)) {
+				break;
+			}
+			SearchChunk<T>& chunk = chunks[i];
+			const SavePoint chunk_begin = begin + i * chunk_size;
+			const SavePoint chunk_end = end - chunk_begin > chunk_size ? chunk_begin + chunk_size : end;
+			// matches may extend beyond the end of the chunk
+			Context chunk_context(source, SourceLocation(chunk_begin - source.begin(), end - source.begin()));
+			chunk_context.set_limits(limits);
+			SearchMatch<T> match;
+			while (true) {
+				chunk.result = search_next(chunk_context, p, filter, chunk_end, match);
+				if (chunk.result == ERROR) {
+					chunk.error = chunk_context.get_error().to_string();
+					chunk.error_location = match.location;
+					chunk.aborted = chunk_context.is_aborted();
+				}
+				if (chunk.result != SUCCESS) {
+					break;
+				}
+				chunk.matches.push_back(std::move(match));
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				chunk.done = true;
+			}
+			condition.notify_all();
+		}
+	};
+	std::vector<std::thread> workers;
+	for (unsigned int i = 0; i < thread_count; ++i) {
+		workers.emplace_back(worker);
+	}
+	Result result = SUCCESS;
+	SavePoint resume = begin;
+	for (std::size_t i = 0; i < chunk_count; ++i) {
+		SearchChunk<T>& chunk = chunks[i];
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [&]() {
+				return chunk.done;
+			});
+		}
+		const SavePoint chunk_begin = begin + i * chunk_size;
+		const SavePoint chunk_end = end - chunk_begin > chunk_size ? chunk_begin + chunk_size : end;
+		std::size_t j = 0;
+		if (resume > chunk_begin) {
+			// a match of the previous chunk extends into this chunk; search again from its end until a match agrees with this chunk
+			context.restore(resume);
+			SearchMatch<T> match;
+			while (true) {
+				const Result next = search_next(context, p, filter, chunk_end, match);
+				if (next == ERROR) {
+					result = context.is_aborted() ? ABORTED : ERROR;
+					break;
+				}
+				if (next == FAILURE) {
+					j = chunk.matches.size();
+					break;
+				}
+				while (j < chunk.matches.size() && chunk.matches[j].location.begin < match.location.begin) {
+					++j;
+				}
+				if (j < chunk.matches.size() && chunk.matches[j].location.begin == match.location.begin) {
+					break;
+				}
+				match.call(f);
+				resume = source.begin() + match.location.end;
+			}
+			if (result != SUCCESS) {
+				break;
+			}
+		}
+		for (; j < chunk.matches.size(); ++j) {
+			resume = source.begin() + chunk.matches[j].location.end;
+			chunk.matches[j].call(f);
+		}
+		chunk.matches = std::vector<SearchMatch<T>>();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			consumed = i + 1;
+		}
+		condition.notify_all();
+		// an error within a match that began in a previous chunk is not reached by search(); the rest of the chunk was searched again above
+		if (chunk.result == ERROR && source.begin() + chunk.error_location.begin >= resume) {
+			context.restore(source.begin() + chunk.error_location.end);
+			context.set_error(StringView(chunk.error));
+			result = chunk.aborted ? ABORTED : ERROR;
+			break;
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	condition.notify_all();
+	for (std::thread& thread: workers) {
+		thread.join();
+	}
+	if (result == SUCCESS) {
+		context.restore(end);
+	}
+	return result;
+}
+template <class P, class F> parser::Result parallel_search(parser::Context& context, const P& p, F&& f, unsigned int threads = std::thread::hardware_concurrency(), std::size_t chunk_size = 16 * 1024 * 1024) {
+	return parallel_search<void>(context, p, std::forward<F>(f), threads, chunk_size);
+}
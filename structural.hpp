@@ -0,0 +1,149 @@
+#pragma once
+
+#include "common.hpp"
+#include <algorithm>
+
+namespace parser {
+
+// a bit for each of the 64 characters of block that is equal to one of chars
+inline std::uint64_t match_block(const char* block, const StringView& chars) {
+	std::uint64_t mask = 0;
+#ifdef PARSER_SSE2
+	for (unsigned int i = 0; i < 4; ++i) {
+		const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16));
+		__m128i matches = _mm_setzero_si128();
+		for (char c: chars) {
+			matches = _mm_or_si128(matches, _mm_cmpeq_epi8(data, _mm_set1_epi8(c)));
+		}
+		mask |= static_cast<std::uint64_t>(static_cast<unsigned int>(_mm_movemask_epi8(matches))) << i * 16;
+	}
+#else
+	for (unsigned int i = 0; i < 64; ++i) {
+		if (chars.contains(block[i])) {
+			mask |= std::uint64_t(1) << i;
+		}
+	}
+#endif
+	return mask;
+}
+
+inline unsigned int count_bits(std::uint64_t x) {
+#ifdef _MSC_VER
+	return static_cast<unsigned int>(__popcnt64(x));
+#else
+	return __builtin_popcountll(x);
+#endif
+}
+
+// sets every bit from a set bit up to the next set bit (exclusive)
+inline std::uint64_t prefix_xor(std::uint64_t x) {
+	x ^= x << 1;
+	x ^= x << 2;
+	x ^= x << 4;
+	x ^= x << 8;
+	x ^= x << 16;
+	x ^= x << 32;
+	return x;
+}
+
+// the positions of the structural characters of a source that are neither escaped nor within a string literal, together with the quotes themselves
+// built 64 characters at a time in a single pass, similar to the first stage of simdjson
+class StructuralIndex {
+	StringView source;
+	std::string chars;
+	bool has_quotes;
+	char quote;
+	char escape;
+	std::vector<std::size_t> positions;
+	void build() {
+		bool escape_carry = false;
+		std::uint64_t string_carry = 0;
+		char buffer[64];
+		for (std::size_t offset = 0; offset < source.size(); offset += 64) {
+			const char* block = source.data() + offset;
+			std::uint64_t valid = ~std::uint64_t(0);
+			if (source.size() - offset < 64) {
+				// the last block is copied so that nothing is read past the end of the source
+				const std::size_t length = source.size() - offset;
+				std::memcpy(buffer, block, length);
+				std::memset(buffer + length, 0, 64 - length);
+				block = buffer;
+				valid = (std::uint64_t(1) << length) - 1;
+			}
+			std::uint64_t structurals = match_block(block, StringView(chars)) & valid;
+			if (has_quotes) {
+				const std::uint64_t escapes = match_block(block, StringView(&escape, 1)) & valid;
+				// escapes are resolved one at a time, they are rare
+				std::uint64_t escaped = escape_carry ? 1 : 0;
+				escape_carry = false;
+				for (std::uint64_t remaining = escapes; remaining != 0; remaining &= remaining - 1) {
+					const unsigned int i = count_trailing_zeros(remaining);
+					if (escaped >> i & 1) {
+						continue;
+					}
+					if (i == 63) {
+						escape_carry = true;
+					}
+					else {
+						escaped |= std::uint64_t(1) << (i + 1);
+					}
+				}
+				const std::uint64_t quotes = match_block(block, StringView(&quote, 1)) & valid & ~escaped;
+				// the opening quote and the characters of a string literal
+				const std::uint64_t in_string = prefix_xor(quotes) ^ string_carry;
+				string_carry = in_string >> 63 ? ~std::uint64_t(0) : 0;
+				structurals = (structurals & ~in_string & ~escaped) | quotes;
+			}
+			std::size_t count = positions.size();
+			positions.resize(count + count_bits(structurals));
+			for (; structurals != 0; structurals &= structurals - 1) {
+				positions[count] = offset + count_trailing_zeros(structurals);
+				++count;
+			}
+		}
+	}
+public:
+	StructuralIndex(const StringView& source, const StringView& chars): source(source), chars(chars.to_string()), has_quotes(false), quote('\0'), escape('\0') {
+		build();
+	}
+	StructuralIndex(const StringView& source, const StringView& chars, char quote, char escape): source(source), chars(chars.to_string()), has_quotes(true), quote(quote), escape(escape) {
+		build();
+	}
+	const StringView& get_source() const {
+		return source;
+	}
+	bool is_structural(char c) const {
+		return StringView(chars).contains(c);
+	}
+	// whether string literals are delimited by quote and escape, or not recognized if quote is '\0'
+	bool has_strings(char quote, char escape) const {
+		return quote == '\0' ? !has_quotes : has_quotes && this->quote == quote && this->escape == escape;
+	}
+	std::size_t size() const {
+		return positions.size();
+	}
+	std::size_t operator [](std::size_t i) const {
+		return positions[i];
+	}
+	// the index of the first structural position at or after offset
+	std::size_t lower_bound(std::size_t offset) const {
+		return std::lower_bound(positions.begin(), positions.end(), offset) - positions.begin();
+	}
+	// the locations of the records that are separated by the structural character c
+	std::vector<SourceLocation> split(char c) const {
+		std::vector<SourceLocation> records;
+		std::size_t begin = 0;
+		for (std::size_t position: positions) {
+			if (source[position] == c) {
+				records.emplace_back(begin, position);
+				begin = position + 1;
+			}
+		}
+		if (begin < source.size()) {
+			records.emplace_back(begin, source.size());
+		}
+		return records;
+	}
+};
+
+}